@@ -5,6 +5,7 @@
 #include <BitSequence.h>
 #include <BitString.h>
 #include <BitSequenceFactory.h>
+#include <GapScan.h>
 
 
 using std::string;
@@ -54,11 +55,7 @@ int main(int argc, char **argv)
         getline(s, buf);
 
         BitString bstr(buf.size());
-
-        for (size_t i = 0; i < buf.size(); ++i)
-        {
-            bstr.setBit(i, buf[i] != '-');
-        }
+        FillNonGapBits(buf.data(), buf.size(), bstr);
 
         seq = factory->getInstance(bstr);
 
@@ -0,0 +1,75 @@
+/*
+** This sample program loads a MAF file and writes an alignment index
+** which can be queried directly from a memory mapping using
+** MappedAlignment. Given a memory budget in megabytes, the index is built
+** out of core instead, without loading the alignment.
+*/
+
+#include <string>
+#include <ctime>
+#include <cstdlib>
+#include <iostream>
+
+#include <MafReader.h>
+#include <WholeGenomeAlignment.h>
+#include <BinSearchAlignmentBlockStorage.h>
+#include <MappedAlignment.h>
+#include <BitSequenceFactory.h>
+
+
+using std::string;
+using std::clock;
+
+string progname;
+
+void usage()
+{
+    cerr << "Usage: " << progname << " <file.maf> <reference> <output> "
+        "[<budget in MB>]" << endl;
+    exit(1);
+}
+
+inline double clock_to_sec(clock_t time_interval)
+{
+    return time_interval / (double)CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    progname = argv[0];
+    if (argc != 4 && argc != 5)
+    {
+        usage();
+    }
+
+    clock_t start = clock();
+    if (argc == 5)
+    {
+        size_t budget = size_t(std::atol(argv[4])) << 20;
+        maf_reader::BuildMappedAlignment(argv[1], argv[2], argv[3], budget,
+                maf_reader::ReadOptions());
+        cerr.precision(10);
+        cerr << "Built index in " << clock_to_sec(clock() - start) <<
+                " seconds." << endl;
+        return 0;
+    }
+
+    WholeGenomeAlignment wga(argv[2], new BinSearchAlignmentBlockStorage());
+
+    {
+        // The index has its own bit vector layout, the cheapest
+        // representation is good enough for the intermediate alignment.
+        BitSequenceRGFactory factory(20);
+        maf_reader::ReadMafFile(argv[1], wga, factory);
+    }
+    clock_t end = clock();
+    cerr.precision(10);
+    cerr << "Parsed MAF in " << clock_to_sec(end - start) <<
+            " seconds." << endl;
+
+    start = clock();
+    WriteMappedAlignment(wga, argv[3]);
+    end = clock();
+    cerr << "Wrote index in " << clock_to_sec(end - start) <<
+            " seconds." << endl;
+}
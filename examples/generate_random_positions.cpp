@@ -14,6 +14,12 @@
 #include <WholeGenomeAlignment.h>
 #include <BinSearchAlignmentBlockStorage.h>
 #include <RankAlignmentBlockStorage.h>
+#include <EytzingerAlignmentBlockStorage.h>
+#include <STreeAlignmentBlockStorage.h>
+#include <EliasFanoAlignmentBlockStorage.h>
+#include <LearnedAlignmentBlockStorage.h>
+#include <BucketAlignmentBlockStorage.h>
+#include <OverlapAlignmentBlockStorage.h>
 #include <BitSequenceFactory.h>
 
 
@@ -31,7 +37,8 @@ string progname;
 void usage()
 {
     cerr << "Usage: " << progname << " <file.maf> <reference> "
-        "RG2|RG3|RG4|RG20|RRR|SDArray binsearch|rank "
+        "RG2|RG3|RG4|RG20|RRR|SDArray "
+        "binsearch|rank|eytzinger|stree|eliasfano|learned|bucket|overlap "
         "[seqname seqname ...]" << endl;
     exit(1);
 }
@@ -55,6 +62,18 @@ AlignmentBlockStorage * GetAlignmentBlockStorage(const string &param)
 {
     if (param == "binsearch")
         return new BinSearchAlignmentBlockStorage();
+    if (param == "eytzinger")
+        return new EytzingerAlignmentBlockStorage();
+    if (param == "stree")
+        return new STreeAlignmentBlockStorage();
+    if (param == "eliasfano")
+        return new EliasFanoAlignmentBlockStorage();
+    if (param == "learned")
+        return new LearnedAlignmentBlockStorage();
+    if (param == "bucket")
+        return new BucketAlignmentBlockStorage();
+    if (param == "overlap")
+        return new OverlapAlignmentBlockStorage();
     return new RankAlignmentBlockStorage();
 }
 
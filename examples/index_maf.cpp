@@ -0,0 +1,53 @@
+/*
+** This sample program scans a MAF file once and writes a sidecar index
+** listing the location of each block, which lets
+** LazyAlignmentBlockStorage parse blocks only when they are queried.
+*/
+
+#include <string>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+#include <MafIndex.h>
+
+
+using std::string;
+using std::clock;
+using std::cerr;
+using std::endl;
+
+string progname;
+
+void usage()
+{
+    cerr << "Usage: " << progname << " <file.maf> <reference> <output>"
+        << endl;
+    exit(1);
+}
+
+inline double clock_to_sec(clock_t time_interval)
+{
+    return time_interval / (double)CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    progname = argv[0];
+    if (argc != 4)
+    {
+        usage();
+    }
+
+    clock_t start = clock();
+    maf_reader::MafIndex *index = maf_reader::IndexMafFile(argv[1],
+            argv[2]);
+    clock_t end = clock();
+    cerr.precision(10);
+    cerr << "Indexed " << index->blocks.size() << " blocks in " <<
+            clock_to_sec(end - start) << " seconds." << endl;
+
+    std::ofstream out(argv[3], std::ios::binary);
+    index->save(out);
+    delete index;
+}
@@ -0,0 +1,84 @@
+/*
+** This sample program loads several MAF files, such as a directory of
+** per-chromosome UCSC alignments, into a single alignment using a given
+** number of threads and saves a snapshot of the result.
+*/
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+#include <MafReader.h>
+#include <WholeGenomeAlignment.h>
+#include <RankAlignmentBlockStorage.h>
+#include <BitSequenceFactory.h>
+
+
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+
+string progname;
+
+void usage()
+{
+    cerr << "Usage: " << progname << " <reference> <threads> <output> "
+        "<file.maf|directory>..." << endl;
+    exit(1);
+}
+
+class ProgressPrinter: public maf_reader::ReadStatsSink
+{
+    public:
+        virtual void progress(const maf_reader::ReadStats &stats)
+        {
+            cerr << "Read " << stats.bytes_read / (1 << 20) << " MiB in "
+                << stats.total_time << " seconds." << endl;
+        }
+        virtual void finished(const maf_reader::ReadStats &stats)
+        {
+            cerr << "Loaded " << stats.paragraphs << " blocks in "
+                << stats.total_time << " seconds." << endl;
+        }
+};
+
+int main(int argc, char **argv)
+{
+    progname = argv[0];
+    if (argc < 5)
+    {
+        usage();
+    }
+
+    vector<string> file_names;
+    for (int i = 4; i < argc; ++i)
+    {
+        struct stat info;
+        if (stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            vector<string> listed = maf_reader::ListMafFiles(argv[i]);
+            file_names.insert(file_names.end(), listed.begin(),
+                    listed.end());
+        }
+        else
+        {
+            file_names.push_back(argv[i]);
+        }
+    }
+
+    WholeGenomeAlignment wga(argv[1], new RankAlignmentBlockStorage());
+    BitSequenceRGFactory factory(2);
+    ProgressPrinter printer;
+    maf_reader::ReadOptions options;
+    options.threads = std::atoi(argv[2]);
+    options.stats = &printer;
+    options.progress_interval = 10;
+    maf_reader::ReadMafFiles(file_names, wga, factory, options);
+
+    std::ofstream out(argv[3], std::ios::binary);
+    wga.save(out);
+}
@@ -13,6 +13,12 @@
 #include <WholeGenomeAlignment.h>
 #include <BinSearchAlignmentBlockStorage.h>
 #include <RankAlignmentBlockStorage.h>
+#include <EytzingerAlignmentBlockStorage.h>
+#include <STreeAlignmentBlockStorage.h>
+#include <EliasFanoAlignmentBlockStorage.h>
+#include <LearnedAlignmentBlockStorage.h>
+#include <BucketAlignmentBlockStorage.h>
+#include <OverlapAlignmentBlockStorage.h>
 #include <BitSequenceFactory.h>
 
 #include "referenced_memory_size.h"
@@ -30,7 +36,9 @@ string progname;
 void usage()
 {
     cerr << "Usage: " << progname << " <file.maf> <reference> "
-        "RG2|RG3|RG4|RG20|RRR|SDArray|dummy binsearch|rank" << endl;
+        "RG2|RG3|RG4|RG20|RRR|SDArray|dummy "
+        "binsearch|rank|eytzinger|stree|eliasfano|learned|bucket|"
+        "overlap" << endl;
     exit(1);
 }
 
@@ -55,6 +63,18 @@ AlignmentBlockStorage * GetAlignmentBlockStorage(const string &param)
 {
     if (param == "binsearch")
         return new BinSearchAlignmentBlockStorage();
+    if (param == "eytzinger")
+        return new EytzingerAlignmentBlockStorage();
+    if (param == "stree")
+        return new STreeAlignmentBlockStorage();
+    if (param == "eliasfano")
+        return new EliasFanoAlignmentBlockStorage();
+    if (param == "learned")
+        return new LearnedAlignmentBlockStorage();
+    if (param == "bucket")
+        return new BucketAlignmentBlockStorage();
+    if (param == "overlap")
+        return new OverlapAlignmentBlockStorage();
     return new RankAlignmentBlockStorage();
 }
 
@@ -63,6 +83,29 @@ inline double clock_to_sec(clock_t time_interval)
     return time_interval / (double)CLOCKS_PER_SEC;
 }
 
+// Prints the progress of reading the MAF file and a breakdown of where
+// the time went.
+class ProgressPrinter: public maf_reader::ReadStatsSink
+{
+    public:
+        virtual void progress(const maf_reader::ReadStats &stats)
+        {
+            cerr << "Read " << stats.bytes_read / (1 << 20) << " MiB, "
+                << stats.paragraphs << " blocks in " << stats.total_time
+                << " seconds." << endl;
+        }
+        virtual void finished(const maf_reader::ReadStats &stats)
+        {
+            cerr << "Read " << stats.bytes_read << " bytes, "
+                << stats.paragraphs << " blocks, " << stats.rows
+                << " rows." << endl
+                << "  tokenizing:        " << stats.tokenize_time << endl
+                << "  building rows:     " << stats.build_time << endl
+                << "  resolving IDs:     " << stats.resolve_time << endl
+                << "  preparing storage: " << stats.prepare_time << endl;
+        }
+};
+
 int main(int argc, char **argv)
 {
     progname = argv[0];
@@ -73,22 +116,21 @@ int main(int argc, char **argv)
 
     size_t referenced_before = get_referenced_memory_size();
     clock_t start = clock();
-    WholeGenomeAlignment wga(argv[2], GetAlignmentBlockStorage(argv[4]));
+    AlignmentBlockStorage *storage = GetAlignmentBlockStorage(argv[4]);
+    WholeGenomeAlignment wga(argv[2], storage);
 
     {
         BitSequenceFactory * factory = GetSequenceFactory(argv[3]);
 
-        maf_reader::ReadMafFile(argv[1], wga, *factory);
+        // The storage gets prepared as part of gathering the statistics.
+        ProgressPrinter printer;
+        maf_reader::ReadOptions options;
+        options.stats = &printer;
+        options.progress_interval = 10;
+        maf_reader::ReadMafFile(argv[1], wga, *factory, options);
 
         delete factory;
     }
-    // Make the block storage perform the preprocessing.
-    try
-    {
-        wga.mapPositionToInformant(wga.getReferenceSize() / 2, "any");
-    }
-    catch (...)
-    { }
     clock_t end = clock();
     cerr.precision(10);
     cerr << "Parsed MAF in " << clock_to_sec(end - start) <<
@@ -98,12 +140,15 @@ int main(int argc, char **argv)
     start = clock();
     string informant;
     size_t position;
+    // Queries usually come sorted, each close to the previous one.
+    QueryCursor cursor;
     while (cin >> informant >> position)
     {
         ++attempts;
         try
         {
-            position = wga.mapPositionToInformant(position, informant);
+            position = wga.mapPositionToInformant(position, informant,
+                    cursor);
             // Output the result in BED format.
             size_t dot = informant.find('c');
             if (dot < informant.size())
@@ -133,4 +178,14 @@ int main(int argc, char **argv)
     cerr << "Referenced before:\t" << referenced_before << endl;
     cerr << "Referenced after:\t" << referenced_after << endl;
     cerr << "Referenced diff:\t" << referenced_diff << endl;
+
+    LearnedAlignmentBlockStorage *learned =
+        dynamic_cast<LearnedAlignmentBlockStorage *>(storage);
+    if (learned != NULL)
+    {
+        LearnedIndexStats model = learned->getStats();
+        cerr << "Model segments:\t" << model.segments << endl;
+        cerr << "Model bytes:\t" << model.model_size << endl;
+        cerr << "Model max error:\t" << model.max_error << endl;
+    }
 }
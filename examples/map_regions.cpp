@@ -13,6 +13,12 @@
 #include <WholeGenomeAlignment.h>
 #include <BinSearchAlignmentBlockStorage.h>
 #include <RankAlignmentBlockStorage.h>
+#include <EytzingerAlignmentBlockStorage.h>
+#include <STreeAlignmentBlockStorage.h>
+#include <EliasFanoAlignmentBlockStorage.h>
+#include <LearnedAlignmentBlockStorage.h>
+#include <BucketAlignmentBlockStorage.h>
+#include <OverlapAlignmentBlockStorage.h>
 #include <BitSequenceFactory.h>
 
 #include "referenced_memory_size.h"
@@ -30,7 +36,9 @@ string progname;
 void usage()
 {
     cerr << "Usage: " << progname << " <file.maf> <reference> "
-        "RG2|RG3|RG4|RG20|RRR|SDArray|dummy binsearch|rank" << endl;
+        "RG2|RG3|RG4|RG20|RRR|SDArray|dummy "
+        "binsearch|rank|eytzinger|stree|eliasfano|learned|bucket|"
+        "overlap" << endl;
     exit(1);
 }
 
@@ -55,6 +63,18 @@ AlignmentBlockStorage * GetAlignmentBlockStorage(const string &param)
 {
     if (param == "binsearch")
         return new BinSearchAlignmentBlockStorage();
+    if (param == "eytzinger")
+        return new EytzingerAlignmentBlockStorage();
+    if (param == "stree")
+        return new STreeAlignmentBlockStorage();
+    if (param == "eliasfano")
+        return new EliasFanoAlignmentBlockStorage();
+    if (param == "learned")
+        return new LearnedAlignmentBlockStorage();
+    if (param == "bucket")
+        return new BucketAlignmentBlockStorage();
+    if (param == "overlap")
+        return new OverlapAlignmentBlockStorage();
     return new RankAlignmentBlockStorage();
 }
 
@@ -0,0 +1,108 @@
+/*
+** This sample program loads a MAF file and saves a snapshot of the
+** resulting alignment, which can later be restored using
+** WholeGenomeAlignment::load without parsing the MAF again.
+*/
+
+#include <string>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+#include <MafReader.h>
+#include <WholeGenomeAlignment.h>
+#include <BinSearchAlignmentBlockStorage.h>
+#include <RankAlignmentBlockStorage.h>
+#include <EytzingerAlignmentBlockStorage.h>
+#include <STreeAlignmentBlockStorage.h>
+#include <EliasFanoAlignmentBlockStorage.h>
+#include <LearnedAlignmentBlockStorage.h>
+#include <BucketAlignmentBlockStorage.h>
+#include <OverlapAlignmentBlockStorage.h>
+#include <BitSequenceFactory.h>
+
+
+using std::string;
+using std::clock;
+
+string progname;
+
+void usage()
+{
+    cerr << "Usage: " << progname << " <file.maf> <reference> "
+        "RG2|RG3|RG4|RG20|RRR|SDArray "
+        "binsearch|rank|eytzinger|stree|eliasfano|learned|bucket|overlap "
+        "<output>" << endl;
+    exit(1);
+}
+
+BitSequenceFactory * GetSequenceFactory(const string &param)
+{
+    if (param == "RRR")
+        return new BitSequenceRRRFactory();
+    if (param == "SDArray")
+        return new BitSequenceSDArrayFactory();
+    if (param == "RG3")
+        return new BitSequenceRGFactory(3);
+    if (param == "RG4")
+        return new BitSequenceRGFactory(4);
+    if (param == "RG20")
+        return new BitSequenceRGFactory(20);
+    return new BitSequenceRGFactory(2);
+}
+
+AlignmentBlockStorage * GetAlignmentBlockStorage(const string &param)
+{
+    if (param == "binsearch")
+        return new BinSearchAlignmentBlockStorage();
+    if (param == "eytzinger")
+        return new EytzingerAlignmentBlockStorage();
+    if (param == "stree")
+        return new STreeAlignmentBlockStorage();
+    if (param == "eliasfano")
+        return new EliasFanoAlignmentBlockStorage();
+    if (param == "learned")
+        return new LearnedAlignmentBlockStorage();
+    if (param == "bucket")
+        return new BucketAlignmentBlockStorage();
+    if (param == "overlap")
+        return new OverlapAlignmentBlockStorage();
+    return new RankAlignmentBlockStorage();
+}
+
+inline double clock_to_sec(clock_t time_interval)
+{
+    return time_interval / (double)CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    progname = argv[0];
+    if (argc != 6)
+    {
+        usage();
+    }
+
+    clock_t start = clock();
+    WholeGenomeAlignment wga(argv[2], GetAlignmentBlockStorage(argv[4]));
+
+    {
+        BitSequenceFactory * factory = GetSequenceFactory(argv[3]);
+
+        maf_reader::ReadMafFile(argv[1], wga, *factory);
+
+        delete factory;
+    }
+    clock_t end = clock();
+    cerr.precision(10);
+    cerr << "Parsed MAF in " << clock_to_sec(end - start) <<
+            " seconds." << endl;
+
+    start = clock();
+    std::ofstream out(argv[5], std::ios::binary);
+    wga.save(out);
+    out.close();
+    end = clock();
+    cerr << "Saved snapshot in " << clock_to_sec(end - start) <<
+            " seconds." << endl;
+}
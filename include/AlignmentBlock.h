@@ -5,9 +5,11 @@
 #include <map>
 #include <string>
 #include <exception>
+#include <fstream>
 
 #include <SequenceDetails.h>
 #include <MultialnConstants.h>
+#include <Arena.h>
 
 
 class SequenceDoesNotExist: public std::exception
@@ -23,6 +25,8 @@ class AlignmentBlock
 {
     public:
         typedef std::map<seqid_t, size_t> PositionMapping;
+        typedef ArenaAllocator<SequenceDetails> RowAllocator;
+        typedef std::vector<SequenceDetails, RowAllocator> Rows;
 
         AlignmentBlock():
             prepared_(false)
@@ -64,12 +68,48 @@ class AlignmentBlock
             return this->getSequence(kReferenceSequenceId);
         }
 
+        /*
+        ** Returns all sequences of this block ordered by their IDs.
+        */
+        const Rows & getSequences()
+        {
+            this->prepare();
+            return this->sequences_;
+        }
+
         void addSequence(const SequenceDetails &details)
         {
             this->prepared_ = false;
             this->sequences_.push_back(details);
         }
 
+        /*
+        ** Moves the rows, in their prepared order, into memory taken from
+        ** allocator, so that the rows of blocks compacted one after
+        ** another follow each other. The BitSequences are shared, not
+        ** copied. Pointers to rows obtained before are no longer valid;
+        ** the block itself stays where it is.
+        */
+        void compactRows(const RowAllocator &allocator);
+        /*
+        ** Returns true if the rows live in an arena.
+        */
+        bool hasCompactRows() const
+        {
+            return this->sequences_.get_allocator().get_arena() != NULL;
+        }
+
+        /*
+        ** Writes all rows of this block to fp, which has to be opened in
+        ** binary mode.
+        */
+        void save(std::ofstream &fp);
+        /*
+        ** Reads a block previously written by save. Throws SnapshotError
+        ** if the data can't be read.
+        */
+        static AlignmentBlock * load(std::ifstream &fp);
+
         static bool compareReferencePosition(AlignmentBlock *a,
                 AlignmentBlock *b)
         {
@@ -79,7 +119,7 @@ class AlignmentBlock
 
 
     private:
-        typedef std::vector<SequenceDetails> Container;
+        typedef Rows Container;
         Container sequences_;
         bool prepared_;
 
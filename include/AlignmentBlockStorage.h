@@ -3,10 +3,57 @@
 
 #include <AlignmentBlock.h>
 #include <iterator>
+#include <vector>
+#include <fstream>
 
 
-// forward declaration
+// forward declarations
 class AlignmentBlockStorageIterator;
+class WholeGenomeAlignment;
+
+/*
+** Remembers where the last lookup made through it ended up, so that the
+** next one can start searching from there. Streams of queries sorted by
+** position, or clustered around a few places, then mostly hit the same
+** or a neighbouring block and cost next to nothing.
+**
+** The hint is only a starting point and is checked before being used, so
+** a cursor may be reused even after the storage has changed. It must not
+** be shared among threads; each thread should have its own.
+*/
+class QueryCursor
+{
+    public:
+        static const size_t kNoHint = static_cast<size_t>(-1);
+
+        QueryCursor():
+            hint_(kNoHint)
+        { }
+
+        /*
+        ** Forgets the last lookup, e. g. before a query far away from it.
+        */
+        void reset()
+        {
+            this->hint_ = kNoHint;
+        }
+
+        /*
+        ** The following are used by storages to keep their position; its
+        ** meaning is up to them.
+        */
+        size_t getHint() const
+        {
+            return this->hint_;
+        }
+        void setHint(size_t hint)
+        {
+            this->hint_ = hint;
+        }
+
+    private:
+        size_t hint_;
+};
 
 class AlignmentBlockStorage
 {
@@ -17,6 +64,14 @@ class AlignmentBlockStorage
         { }
         virtual void addBlock(AlignmentBlock *) = 0;
 
+        /*
+        ** Called by the WholeGenomeAlignment taking over this storage.
+        ** Storages which create blocks on their own can use wga to
+        ** register sequences.
+        */
+        virtual void attach(WholeGenomeAlignment &)
+        { }
+
         /*
         ** Returns an Iterator pointing to the last block whose starting
         ** position on the reference sequence compares less than or equal
@@ -35,6 +90,17 @@ class AlignmentBlockStorage
         */
         virtual AlignmentBlock * getBlock(const size_t pos);
 
+        /*
+        ** Same as getBlock, but starts the search where the last lookup
+        ** made with cursor ended and updates it. Storages which can't make
+        ** use of the cursor search the whole of their index.
+        **
+        ** The storage has to be prepared before the same storage is
+        ** queried from several threads, each using its own cursor.
+        */
+        virtual AlignmentBlock * getBlockNear(const size_t pos,
+                QueryCursor &cursor);
+
         /*
         ** Analogic to the STL begin method on containers, returns an
         ** iterator pointing to the first block.
@@ -51,139 +117,228 @@ class AlignmentBlockStorage
         ** Returns the number of blocks contained within this storage.
         */
         virtual size_t size() const = 0;
-};
 
-/*
-** Inspiration for the following iterator implementation taken from
-** http://www.ocoudert.com/blog/2010/07/07/how-to-write-abstract-iterators-in-c/
-*/
-
-/*
-** This is the class providing the actual iteration. It should be
-** subclassed by concrete AlignmentBlockStorage implementations.
-*/
-class AlignmentBlockStorageIteratorImplementation
-{
-    public:
-        typedef std::forward_iterator_tag iterator_category;
-        typedef AlignmentBlock value_type;
-        typedef AlignmentBlock * pointer;
-        typedef AlignmentBlock & reference;
-        typedef ptrdiff_t difference_type;
-
-        AlignmentBlockStorageIteratorImplementation()
-        { }
-        virtual ~AlignmentBlockStorageIteratorImplementation()
+        /*
+        ** Builds the search structure of this storage, unless it is up to
+        ** date. Lookups do so on their own when needed; calling this
+        ** explicitly lets the caller choose when to pay for it.
+        */
+        virtual void prepare()
         { }
-
-        virtual AlignmentBlockStorageIteratorImplementation * clone() const
+        /*
+        ** Same as prepare, but spreads the work over the given number of
+        ** threads, as far as the storage is able to. Meant to be called
+        ** right after loading, instead of leaving the whole cost to the
+        ** first lookup.
+        */
+        virtual void prepare(size_t threads)
         {
-            return new AlignmentBlockStorageIteratorImplementation();
+            (void) threads;
+            this->prepare();
         }
 
-        virtual reference operator*() const
-        {
-            static value_type dummy;
-            return dummy;
-        }
-        virtual pointer operator->() const
-        {
-            return NULL;
-        }
-        virtual AlignmentBlockStorageIteratorImplementation & operator++()
-        {
-            return *this;
-        }
-        bool operator==(
-                const AlignmentBlockStorageIteratorImplementation &other) const
+        /*
+        ** Writes all blocks, in reference order, followed by the search
+        ** structure of this storage to fp.
+        */
+        void save(std::ofstream &fp);
+
+        /*
+        ** Adds the blocks written by save to this storage. The saved
+        ** search structure is reused if this storage is empty and of the
+        ** same kind as the saved one; otherwise it is skipped and this
+        ** storage builds its own when needed.
+        **
+        ** Throws SnapshotError if the data can't be read.
+        */
+        void load(std::ifstream &fp);
+
+    protected:
+        /*
+        ** Sorts blocks by their reference position. Blocks usually arrive
+        ** in a few sorted runs, one per MAF file, so the runs are merged
+        ** instead of sorting everything again; sorted input costs a
+        ** single pass. With more threads, the blocks are split into equal
+        ** parts sorted concurrently, and the merges of each round run
+        ** concurrently as well.
+        */
+        static void sortBlocks(std::vector<AlignmentBlock *> &blocks,
+                size_t threads = 1);
+
+        /*
+        ** The following let implementations store their search structure
+        ** in snapshots. The structure is tagged with indexName(), which
+        ** has to be unique among implementations. loadIndex is only called
+        ** right after the blocks of the snapshot have been added to an
+        ** empty storage.
+        */
+        virtual const char * indexName() const
         {
-            return (typeid(*this) == typeid(other)) && this->equal(other);
+            return "";
         }
+        virtual void saveIndex(std::ofstream &)
+        { }
+        virtual void loadIndex(std::ifstream &)
+        { }
 
-    protected:
-        virtual bool equal(
-                const AlignmentBlockStorageIteratorImplementation &) const
+        /*
+        ** The following give iterators access to the blocks by their
+        ** position in reference order. Implementations keeping their
+        ** blocks in a contiguous array return it from blockArray, which
+        ** spares a virtual call on every dereference.
+        */
+        friend class AlignmentBlockStorageIterator;
+        virtual AlignmentBlock * blockAt(size_t index) = 0;
+        virtual AlignmentBlock * const * blockArray()
         {
-            return true;
+            return NULL;
         }
 };
 
 /*
-** This class is used to iterate over the storage contents. It is
-** implemented as a forward iterator and is what the user will be facing.
+** Random access iterator over the blocks of a storage, in reference
+** order. It is just a position within the storage, so copying and moving
+** it costs nothing; if the storage keeps its blocks in a contiguous
+** array, dereferencing reads the array directly, otherwise it asks the
+** storage for the block.
+**
+** Like with std::vector, adding blocks invalidates all iterators.
 */
-// TODO: define behavior beyond the storage
 class AlignmentBlockStorageIterator
 {
     public:
         // iterator_traits requirements
-        typedef std::forward_iterator_tag iterator_category;
+        typedef std::random_access_iterator_tag iterator_category;
         typedef AlignmentBlock value_type;
         typedef AlignmentBlock * pointer;
         typedef AlignmentBlock & reference;
         typedef ptrdiff_t difference_type;
 
         AlignmentBlockStorageIterator():
-            implementation_(new AlignmentBlockStorageIteratorImplementation)
+            storage_(NULL), blocks_(NULL), index_(0)
         { }
-        AlignmentBlockStorageIterator(
-                const AlignmentBlockStorageIterator &other):
-            implementation_(other.implementation_->clone())
+        AlignmentBlockStorageIterator(AlignmentBlockStorage *storage,
+                size_t index):
+            storage_(storage), blocks_(storage->blockArray()), index_(index)
         { }
-        AlignmentBlockStorageIterator(
-                const AlignmentBlockStorageIteratorImplementation &impl):
-            implementation_(impl.clone())
-        { }
-        ~AlignmentBlockStorageIterator()
-        {
-            delete this->implementation_;
-        }
 
-        AlignmentBlockStorageIterator & operator=(
-                const AlignmentBlockStorageIterator &other)
+        /*
+        ** Returns the position of the block pointed to within the storage.
+        */
+        size_t index() const
         {
-            if (this->implementation_ != other.implementation_)
-            {
-                delete this->implementation_;
-                this->implementation_ = other.implementation_->clone();
-            }
-            return *this;
+            return this->index_;
         }
 
         // Forward iterator requirements
         reference operator*() const
         {
-            return **(this->implementation_);
+            return *(this->operator->());
         }
-        AlignmentBlockStorageIteratorImplementation & operator->() const
+        pointer operator->() const
         {
-            return *(this->implementation_);
+            if (this->blocks_ != NULL)
+            {
+                return this->blocks_[this->index_];
+            }
+            return this->storage_->blockAt(this->index_);
         }
         AlignmentBlockStorageIterator & operator++()
         {
-            ++(*(this->implementation_));
+            ++(this->index_);
             return *this;
         }
         AlignmentBlockStorageIterator operator++(int)
         {
             AlignmentBlockStorageIterator temp(*this);
-            ++(*this);
+            ++(this->index_);
             return temp;
         }
 
         bool operator==(const AlignmentBlockStorageIterator &other) const
         {
-            return (this->implementation_ == other.implementation_)
-                || (*(this->implementation_) == *(other.implementation_));
+            return this->index_ == other.index_
+                && this->storage_ == other.storage_;
         }
         bool operator!=(const AlignmentBlockStorageIterator &other) const
         {
             return !(*this == other);
         }
 
+        // Bidirectional iterator requirements
+        AlignmentBlockStorageIterator & operator--()
+        {
+            --(this->index_);
+            return *this;
+        }
+        AlignmentBlockStorageIterator operator--(int)
+        {
+            AlignmentBlockStorageIterator temp(*this);
+            --(this->index_);
+            return temp;
+        }
+
+        // Random access iterator requirements
+        AlignmentBlockStorageIterator & operator+=(difference_type n)
+        {
+            this->index_ += n;
+            return *this;
+        }
+        AlignmentBlockStorageIterator & operator-=(difference_type n)
+        {
+            this->index_ -= n;
+            return *this;
+        }
+        AlignmentBlockStorageIterator operator+(difference_type n) const
+        {
+            AlignmentBlockStorageIterator temp(*this);
+            return temp += n;
+        }
+        AlignmentBlockStorageIterator operator-(difference_type n) const
+        {
+            AlignmentBlockStorageIterator temp(*this);
+            return temp -= n;
+        }
+        difference_type operator-(
+                const AlignmentBlockStorageIterator &other) const
+        {
+            return difference_type(this->index_)
+                - difference_type(other.index_);
+        }
+        reference operator[](difference_type n) const
+        {
+            return *(*this + n);
+        }
+        bool operator<(const AlignmentBlockStorageIterator &other) const
+        {
+            return this->index_ < other.index_;
+        }
+        bool operator>(const AlignmentBlockStorageIterator &other) const
+        {
+            return other < *this;
+        }
+        bool operator<=(const AlignmentBlockStorageIterator &other) const
+        {
+            return !(other < *this);
+        }
+        bool operator>=(const AlignmentBlockStorageIterator &other) const
+        {
+            return !(*this < other);
+        }
+
     private:
-        AlignmentBlockStorageIteratorImplementation *implementation_;
+        AlignmentBlockStorage *storage_;
+        // The blocks of storage_, if they are kept in an array.
+        AlignmentBlock * const *blocks_;
+        size_t index_;
 };
 
+inline AlignmentBlockStorageIterator operator+(
+        AlignmentBlockStorageIterator::difference_type n,
+        const AlignmentBlockStorageIterator &it)
+{
+    return it + n;
+}
+
 
 #endif /* ALIGNMENTBLOCKSTORAGE_H */
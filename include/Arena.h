@@ -0,0 +1,128 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+
+/*
+** Hands out memory from a few large chunks, one after another, so that
+** objects allocated in a row end up next to each other. Nothing is freed
+** until the arena itself is destroyed; destroying the objects allocated
+** from it is up to their owner.
+*/
+class Arena
+{
+    public:
+        static const size_t kChunkSize = 1 << 20;
+
+        /*
+        ** The first chunk takes expected bytes, so that an arena whose
+        ** final size is known takes a single one; any further chunks
+        ** double the size up to kChunkSize. Without an expected size,
+        ** chunks take kChunkSize bytes.
+        */
+        explicit Arena(size_t expected = 0):
+            expected_(expected), current_(NULL), left_(0), size_(0)
+        { }
+        ~Arena();
+
+        /*
+        ** Returns bytes of memory aligned to alignment, which has to be
+        ** a power of two no larger than that of operator new.
+        */
+        void * allocate(size_t bytes, size_t alignment);
+
+        /*
+        ** Returns the number of bytes taken from the system.
+        */
+        size_t getSize() const
+        {
+            return this->size_;
+        }
+
+    private:
+        std::vector<char *> chunks_;
+        size_t expected_;
+        char *current_;
+        size_t left_, size_;
+
+        // The following are forbidden.
+        Arena(const Arena &);
+        Arena & operator=(const Arena &);
+};
+
+/*
+** Standard allocator taking memory from an arena, or from the heap if
+** constructed without one. Deallocation only returns heap memory.
+*/
+template <typename T>
+class ArenaAllocator
+{
+    public:
+        typedef T value_type;
+        typedef T * pointer;
+        typedef const T * const_pointer;
+        typedef T & reference;
+        typedef const T & const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template <typename U>
+        struct rebind
+        {
+            typedef ArenaAllocator<U> other;
+        };
+        // Containers moved or swapped take their arena along.
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        ArenaAllocator(Arena *arena = NULL):
+            arena_(arena)
+        { }
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other):
+            arena_(other.get_arena())
+        { }
+
+        T * allocate(size_t count)
+        {
+            if (this->arena_ != NULL)
+            {
+                return static_cast<T *>(this->arena_->allocate(
+                            count * sizeof(T), __alignof__(T)));
+            }
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        }
+        void deallocate(T *p, size_t)
+        {
+            if (this->arena_ == NULL)
+            {
+                ::operator delete(p);
+            }
+        }
+
+        Arena * get_arena() const
+        {
+            return this->arena_;
+        }
+
+    private:
+        Arena *arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.get_arena() == b.get_arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return !(a == b);
+}
+
+#endif /* ARENA_H */
@@ -0,0 +1,86 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+/*
+** A queue for handing items over between threads, holding at most
+** capacity items at a time. Producers block while the queue is full,
+** consumers while it is empty.
+**
+** Once closed, push refuses new items and pop returns false as soon as
+** the remaining items have been taken out.
+*/
+template <typename T>
+class BoundedQueue
+{
+    public:
+        explicit BoundedQueue(size_t capacity):
+            capacity_(capacity), closed_(false)
+        { }
+
+        /*
+        ** Appends item, waiting for room if necessary. Returns false, without
+        ** adding anything, if the queue has been closed.
+        */
+        bool push(const T &item)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex_);
+            while (!this->closed_ && this->items_.size() >= this->capacity_)
+            {
+                this->not_full_.wait(lock);
+            }
+            if (this->closed_)
+            {
+                return false;
+            }
+            this->items_.push_back(item);
+            this->not_empty_.notify_one();
+            return true;
+        }
+
+        /*
+        ** Takes out the oldest item, waiting for one if necessary. Returns
+        ** false if the queue is closed and empty.
+        */
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex_);
+            while (!this->closed_ && this->items_.empty())
+            {
+                this->not_empty_.wait(lock);
+            }
+            if (this->items_.empty())
+            {
+                return false;
+            }
+            item = this->items_.front();
+            this->items_.pop_front();
+            this->not_full_.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->closed_ = true;
+            this->not_empty_.notify_all();
+            this->not_full_.notify_all();
+        }
+
+    private:
+        size_t capacity_;
+        bool closed_;
+        std::deque<T> items_;
+        std::mutex mutex_;
+        std::condition_variable not_empty_, not_full_;
+
+        // The following are forbidden.
+        BoundedQueue(const BoundedQueue &);
+        BoundedQueue & operator=(const BoundedQueue &);
+};
+
+#endif /* BOUNDEDQUEUE_H */
@@ -0,0 +1,60 @@
+#ifndef BUCKETALIGNMENTBLOCKSTORAGE_H
+#define BUCKETALIGNMENTBLOCKSTORAGE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <AlignmentBlock.h>
+#include <VectorAlignmentBlockStorage.h>
+
+
+/*
+** Implementation of AlignmentBlockStorage which splits the reference into
+** buckets of 2^k positions and keeps a directory with the index of the
+** first block starting in each of them. A lookup goes straight to the
+** bucket of pos and searches only the starts within it.
+**
+** k is chosen so that there are about as many buckets as blocks; with
+** blocks spread evenly along the reference, most buckets hold one or two
+** of them, which makes a lookup take a constant number of cache misses.
+**
+** The directory is built lazily, i. e. the first time a find operation is
+** performed.
+*/
+class BucketAlignmentBlockStorage: public VectorAlignmentBlockStorage
+{
+    public:
+        BucketAlignmentBlockStorage():
+            base_(0), shift_(0)
+        { }
+
+        /*
+        ** Returns the number of positions in a bucket, as a power of two.
+        */
+        unsigned getBucketBits()
+        {
+            this->prepare();
+            return this->shift_;
+        }
+
+    protected:
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
+        {
+            return "bucket";
+        }
+        virtual void buildIndex();
+        virtual void dropIndex();
+
+    private:
+        // Reference starts of contents_.
+        std::vector<size_t> starts_;
+        // Index of the first block starting in each bucket, followed by
+        // the number of blocks.
+        std::vector<size_t> directory_;
+        // Start of the first block, where the first bucket begins.
+        size_t base_;
+        unsigned shift_;
+};
+
+#endif /* BUCKETALIGNMENTBLOCKSTORAGE_H */
@@ -0,0 +1,80 @@
+#ifndef ELIASFANO_H
+#define ELIASFANO_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+
+/*
+** Elias-Fano encoding of a non-decreasing sequence of integers. Each
+** value takes about 2 + log2(universe / count) bits, so the size depends
+** on the number of values and their density, not on the universe alone.
+**
+** Values are added one at a time using push_back after reset; finish has
+** to be called before querying. Alternatively, assign encodes a whole
+** vector of values at once, spreading the work over threads.
+*/
+class EliasFano
+{
+    public:
+        EliasFano():
+            count_(0), added_(0), low_bits_(0), max_high_(0)
+        { }
+
+        /*
+        ** Prepares the encoding of count values, none of them greater than
+        ** max_value. Drops any previous contents.
+        */
+        void reset(size_t count, uint64_t max_value);
+        /*
+        ** Appends value, which must not be lower than the previous one.
+        */
+        void push_back(uint64_t value);
+        /*
+        ** Builds the structures needed by rank.
+        */
+        void finish();
+        /*
+        ** Encodes values, which have to be sorted, dropping any previous
+        ** contents. Same as reset, push_back of each value and finish, but
+        ** consecutive ranges of values are encoded concurrently, using at
+        ** most the given number of threads.
+        */
+        void assign(const std::vector<size_t> &values, size_t threads = 1);
+
+        /*
+        ** Returns the number of values not greater than value.
+        */
+        size_t rank(uint64_t value) const;
+
+        size_t size() const
+        {
+            return this->count_;
+        }
+        /*
+        ** Returns the number of bytes taken up by the encoding.
+        */
+        size_t getSize() const;
+
+    private:
+        size_t count_, added_;
+        unsigned low_bits_;
+        uint64_t max_high_;
+        // Low bits of all values packed together.
+        std::vector<uint64_t> lows_;
+        // The high part h of the i-th value sets bit h + i.
+        std::vector<uint64_t> highs_;
+        // Position in highs_ of every kZeroSample-th zero.
+        std::vector<uint64_t> zero_samples_;
+
+        // Sets the low bits of the index-th value.
+        void setLow(size_t index, uint64_t value);
+        // Samples the zeros of highs_, using at most threads threads.
+        void sampleZeros(size_t threads);
+        uint64_t low(size_t index) const;
+        // Position of the index-th zero (counted from 0) in highs_.
+        uint64_t select0(uint64_t index) const;
+};
+
+#endif /* ELIASFANO_H */
@@ -0,0 +1,37 @@
+#ifndef ELIASFANOALIGNMENTBLOCKSTORAGE_H
+#define ELIASFANOALIGNMENTBLOCKSTORAGE_H
+
+#include <AlignmentBlock.h>
+#include <VectorAlignmentBlockStorage.h>
+#include <EliasFano.h>
+
+
+/*
+** Implementation of AlignmentBlockStorage which answers lookups by rank
+** on an Elias-Fano encoding of the sorted block starts. Unlike the bitmap
+** of RankAlignmentBlockStorage, its size depends on the number of blocks
+** rather than on the length of the reference, at around
+** 2 + log2(reference length / blocks) bits per block, and it is built
+** straight from the starts, without a bitmap in between. Given more
+** threads, prepare collects the starts and encodes consecutive ranges of
+** them concurrently.
+**
+** The encoding is built lazily, i. e. the first time a find operation is
+** performed.
+*/
+class EliasFanoAlignmentBlockStorage: public VectorAlignmentBlockStorage
+{
+    protected:
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
+        {
+            return "eliasfano";
+        }
+        virtual void buildIndex();
+        virtual void dropIndex();
+
+    private:
+        EliasFano starts_;
+};
+
+#endif /* ELIASFANOALIGNMENTBLOCKSTORAGE_H */
@@ -0,0 +1,53 @@
+#ifndef EYTZINGERALIGNMENTBLOCKSTORAGE_H
+#define EYTZINGERALIGNMENTBLOCKSTORAGE_H
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include <AlignmentBlock.h>
+#include <VectorAlignmentBlockStorage.h>
+
+
+/*
+** Implementation of AlignmentBlockStorage which keeps the reference
+** starts of the blocks in a contiguous array of their own, laid out in
+** Eytzinger (breadth-first) order. A search walks down the implicit tree
+** touching only this array, prefetching the cache line holding the
+** descendants a few levels below, and the block is dereferenced only once
+** the search is done.
+**
+** The array is built lazily, i. e. the first time a find operation is
+** performed. Given more threads, prepare fills the subtrees a few levels
+** below the root concurrently.
+*/
+class EytzingerAlignmentBlockStorage: public VectorAlignmentBlockStorage
+{
+    protected:
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
+        {
+            return "eytzinger";
+        }
+        virtual void buildIndex();
+        virtual void dropIndex();
+
+    private:
+        // Reference starts in Eytzinger order, starting at index 1.
+        std::vector<uint64_t> starts_;
+        // Index into contents_ of each element of starts_.
+        std::vector<size_t> blocks_;
+
+        // Fills the subtree rooted at node with the sorted starts from
+        // next on; returns the first one not used.
+        size_t fill(size_t next, size_t node);
+        // Same as fill, but stops levels levels below node; the roots of
+        // the subtrees left out are added to subtrees, each preceded by
+        // the first start it gets.
+        size_t fillTop(size_t next, size_t node, unsigned levels,
+                std::vector<std::pair<size_t, size_t> > &subtrees);
+        // Number of nodes of the subtree rooted at node.
+        size_t subtreeSize(size_t node) const;
+};
+
+#endif /* EYTZINGERALIGNMENTBLOCKSTORAGE_H */
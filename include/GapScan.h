@@ -0,0 +1,21 @@
+#ifndef GAPSCAN_H
+#define GAPSCAN_H
+
+#include <cstddef>
+
+#include <BitString.h>
+
+
+/*
+** Fills the first length bits of bitstr according to a row of alignment
+** text: dashes (aka insertions) are zeroes, everything else is one. The
+** remaining bits of the affected words are cleared.
+**
+** The text is scanned with the widest vector instructions supported by
+** the CPU, which is picked once at runtime. The result is identical to
+** setting each bit separately.
+*/
+void FillNonGapBits(const char *text, size_t length,
+        cds_utils::BitString &bitstr);
+
+#endif /* GAPSCAN_H */
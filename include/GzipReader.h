@@ -0,0 +1,86 @@
+#ifndef GZIPREADER_H
+#define GZIPREADER_H
+
+#include <string>
+#include <vector>
+#include <exception>
+#include <stdint.h>
+#include <zlib.h>
+
+
+class DecompressionError: public std::exception
+{
+    public:
+        DecompressionError() throw(): exception() {};
+        DecompressionError(const DecompressionError &other) throw():
+            exception(other)
+        { }
+};
+
+/*
+** Decompresses gzip data held in memory, one piece after another.
+**
+** Data made of BGZF blocks, as written by bgzip, is decompressed using
+** several threads, since each block can be inflated on its own. The
+** threads are started along with the reader and serve all of its reads.
+** Any other gzip data, including files consisting of several members, is
+** inflated sequentially.
+**
+** Throws DecompressionError if the data is corrupt.
+*/
+class GzipReader
+{
+    public:
+        GzipReader(const char *begin, const char *end, size_t threads=1);
+        ~GzipReader();
+
+        /*
+        ** Appends at least amount bytes of decompressed data to out, unless
+        ** the end of the data is reached first, possibly a little more
+        ** for BGZF data. Returns false once all the data has been read.
+        */
+        bool read(std::string &out, size_t amount);
+
+        /*
+        ** Returns true if the data starts with the gzip magic number.
+        */
+        static bool isGzip(const char *begin, const char *end);
+        /*
+        ** Returns true if the data starts with a BGZF block.
+        */
+        static bool isBgzf(const char *begin, const char *end);
+
+    private:
+        // Location of a single BGZF block.
+        struct BgzfBlock
+        {
+            const char *data;
+            size_t compressed_size, size;
+            uint32_t crc;
+        };
+        // Inflates the BGZF blocks of a read, see GzipReader.cpp.
+        class InflatePool;
+
+        const char *pos_, *end_;
+        size_t threads_;
+        bool bgzf_;
+        // Used for BGZF only.
+        InflatePool *pool_;
+        // Used for plain gzip only.
+        z_stream stream_;
+        bool finished_;
+
+        bool readGzip(std::string &out, size_t amount);
+        bool readBgzf(std::string &out, size_t amount);
+        /*
+        ** Parses the BGZF block header at pos_ and advances pos_ past the
+        ** block.
+        */
+        BgzfBlock nextBgzfBlock();
+
+        // The following are forbidden.
+        GzipReader(const GzipReader &);
+        GzipReader & operator=(const GzipReader &);
+};
+
+#endif /* GZIPREADER_H */
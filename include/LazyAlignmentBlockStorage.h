@@ -0,0 +1,87 @@
+#ifndef LAZYALIGNMENTBLOCKSTORAGE_H
+#define LAZYALIGNMENTBLOCKSTORAGE_H
+
+#include <string>
+#include <unordered_map>
+
+#include <AlignmentBlock.h>
+#include <AlignmentBlockStorage.h>
+#include <MappedFile.h>
+#include <MafIndex.h>
+
+
+// forward declarations
+class BitSequenceFactory;
+
+/*
+** Implementation of AlignmentBlockStorage which serves the blocks of a
+** MAF file described by a MafIndex. A block is only parsed, and its
+** BitSequences built, the first time it is accessed; it is kept around
+** from then on.
+**
+** The storage registers all sequences listed in the index with the
+** WholeGenomeAlignment taking it over, which therefore gets the same
+** sequence IDs as if the whole file had been read. Its reference has to
+** be the one the index has been built for; attach throws SnapshotError
+** otherwise.
+**
+** Lookups parse blocks and add them to the map of materialized ones, so
+** unlike the other storages, this one must not be queried from several
+** threads at the same time, prepared or not.
+**
+** Blocks can't be added by other means; addBlock throws
+** std::logic_error.
+*/
+class LazyAlignmentBlockStorage: public AlignmentBlockStorage
+{
+    public:
+        /*
+        ** Takes over index, which is deleted even if the constructor
+        ** throws. factory has to outlive the storage.
+        **
+        ** Throws FileMappingError if the file can't be mapped and
+        ** SnapshotError if index has not been built from it.
+        */
+        LazyAlignmentBlockStorage(const std::string &maf_file,
+                maf_reader::MafIndex *index, BitSequenceFactory &factory);
+        virtual ~LazyAlignmentBlockStorage();
+        virtual void addBlock(AlignmentBlock *block);
+        /*
+        ** Throws SnapshotError if the reference of wga is not the one the
+        ** index has been built for.
+        */
+        virtual void attach(WholeGenomeAlignment &wga);
+        virtual iterator find(const size_t pos);
+        virtual AlignmentBlock * getBlock(const size_t pos);
+        virtual iterator begin();
+        virtual iterator end();
+        virtual size_t size() const;
+
+        /*
+        ** Returns the number of blocks which have been parsed so far.
+        */
+        size_t countMaterialized() const
+        {
+            return this->blocks_.size();
+        }
+
+    protected:
+        virtual AlignmentBlock * blockAt(size_t index)
+        {
+            return this->materialize(index);
+        }
+
+    private:
+        MappedFile file_;
+        maf_reader::MafIndex *index_;
+        BitSequenceFactory &factory_;
+        WholeGenomeAlignment *wga_;
+        // Only a small fraction of blocks is expected to be touched, so
+        // the parsed ones are looked up by their position in the index.
+        std::unordered_map<size_t, AlignmentBlock *> blocks_;
+
+        AlignmentBlock * materialize(size_t i);
+        size_t findIndex(const size_t pos) const;
+};
+
+#endif /* LAZYALIGNMENTBLOCKSTORAGE_H */
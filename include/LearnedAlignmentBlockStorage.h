@@ -0,0 +1,98 @@
+#ifndef LEARNEDALIGNMENTBLOCKSTORAGE_H
+#define LEARNEDALIGNMENTBLOCKSTORAGE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <AlignmentBlock.h>
+#include <VectorAlignmentBlockStorage.h>
+
+
+/*
+** Size and precision of the model of a LearnedAlignmentBlockStorage.
+*/
+struct LearnedIndexStats
+{
+    LearnedIndexStats():
+        segments(0), model_size(0), max_error(0)
+    { }
+
+    // Number of linear pieces of the model.
+    size_t segments;
+    // Bytes taken up by the pieces.
+    size_t model_size;
+    // Largest distance between the predicted and the actual number of
+    // blocks starting at or before a position.
+    size_t max_error;
+};
+
+/*
+** Implementation of AlignmentBlockStorage which learns the mapping from
+** reference positions to block indices. The number of blocks starting
+** at or before each position is covered by a piecewise-linear function,
+** each piece predicting it to within max_error for every position it
+** covers, runs of blocks sharing a start included; a lookup picks the
+** piece by a binary search among their first starts, which are few when
+** blocks are spread evenly, and then searches only the few starts around
+** the predicted index.
+**
+** The model is built lazily, i. e. the first time a find operation is
+** performed. Given more threads, prepare fits the pieces of consecutive
+** ranges of blocks concurrently, which may add a piece at the boundary
+** of each range.
+*/
+class LearnedAlignmentBlockStorage: public VectorAlignmentBlockStorage
+{
+    public:
+        static const size_t kDefaultMaxError = 32;
+
+        explicit LearnedAlignmentBlockStorage(
+                size_t max_error = kDefaultMaxError):
+            max_error_(max_error), error_(0)
+        { }
+
+        /*
+        ** Returns the size and the precision of the model, building it if
+        ** necessary.
+        */
+        LearnedIndexStats getStats();
+
+    protected:
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
+        {
+            return "learned";
+        }
+        virtual void buildIndex();
+        virtual void dropIndex();
+
+    private:
+        struct Segment
+        {
+            // First start covered and the number of blocks starting at or
+            // before it.
+            size_t key;
+            double intercept;
+            double slope;
+            // Index of the last block covered.
+            size_t last;
+        };
+
+        // The error the model is fitted to.
+        size_t max_error_;
+        // Reference starts of contents_, searched within the window
+        // around the prediction.
+        std::vector<size_t> starts_;
+        std::vector<Segment> segments_;
+        // The error actually reached, rounding included.
+        size_t error_;
+
+        void fit();
+        // Fits the pieces covering the blocks from begin to end, both of
+        // which start a run of equal starts, and appends them to segments;
+        // returns the error reached.
+        size_t fitRange(size_t begin, size_t end,
+                std::vector<Segment> &segments) const;
+};
+
+#endif /* LEARNEDALIGNMENTBLOCKSTORAGE_H */
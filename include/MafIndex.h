@@ -0,0 +1,68 @@
+#ifndef MAFINDEX_H
+#define MAFINDEX_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <stdint.h>
+
+
+namespace maf_reader
+{
+
+/*
+** Location of a single block within a MAF file.
+*/
+struct BlockLocation
+{
+    // First and last position covered on the forward strand of the
+    // reference sequence. reference_start orders blocks the same way as
+    // AlignmentBlock::compareReferencePosition.
+    uint64_t reference_start, reference_end;
+    // Byte range of the block's paragraph within the file.
+    uint64_t offset, length;
+};
+
+/*
+** Sidecar index of a MAF file, listing where each block is located and
+** which part of the reference it covers. It allows individual blocks to
+** be parsed on demand without reading the rest of the file; see
+** LazyAlignmentBlockStorage.
+*/
+struct MafIndex
+{
+    std::string reference;
+    // Size of the indexed file, used to detect stale indices.
+    uint64_t source_size;
+    // Names and sizes of all sequences in order of their first
+    // appearance, which is the order a full read assigns their IDs in.
+    std::vector<std::pair<std::string, size_t> > sequences;
+    // Blocks containing the reference, ordered by reference_start.
+    std::vector<BlockLocation> blocks;
+
+    /*
+    ** Writes the index to fp, which has to be opened in binary mode.
+    */
+    void save(std::ofstream &fp) const;
+    /*
+    ** Reads an index written by save. Throws SnapshotError if fp does not
+    ** contain a valid index.
+    */
+    static MafIndex * load(std::ifstream &fp);
+};
+
+/*
+** Scans the MAF file specified by file_name once and records the location
+** of every block containing the given reference sequence. Only the first
+** fields of "s" lines are tokenized; no BitSequences are built.
+**
+** Throws FileMappingError if the file can't be opened and ParseError if
+** it is malformed.
+*/
+MafIndex * IndexMafFile(const std::string &file_name,
+        const std::string &reference);
+
+} /* namespace maf_reader */
+
+#endif /* MAFINDEX_H */
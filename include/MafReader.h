@@ -3,10 +3,15 @@
 
 #include <string>
 #include <set>
+#include <vector>
+#include <utility>
 #include <istream>
+#include <limits>
+#include <stdint.h>
 
 
 class WholeGenomeAlignment;
+class AlignmentBlock;
 class BitSequenceFactory;
 
 namespace maf_reader
@@ -21,6 +26,108 @@ class ParseError: public std::exception
         { }
 };
 
+/*
+** Statistics about reading a MAF file. Times are wall-clock seconds; the
+** times of the individual phases are summed over all threads doing the
+** given kind of work, so with several threads they may add up to more
+** than total_time.
+*/
+struct ReadStats
+{
+    ReadStats():
+        bytes_read(0), paragraphs(0), rows(0), tokenize_time(0),
+        build_time(0), resolve_time(0), prepare_time(0), total_time(0)
+    { }
+
+    // Bytes of (decompressed) MAF paragraphs scanned so far.
+    uint64_t bytes_read;
+    // Paragraphs and rows tokenized, i. e. not skipped by the filters.
+    uint64_t paragraphs, rows;
+    // Splitting paragraphs into rows and fields.
+    double tokenize_time;
+    // Scanning gaps and BitSequenceFactory::getInstance.
+    double build_time;
+    // WholeGenomeAlignment::requestSequenceId.
+    double resolve_time;
+    // AlignmentBlockStorage::prepare, only known once reading finishes.
+    double prepare_time;
+    // Since the start of ReadMafFile.
+    double total_time;
+};
+
+/*
+** Receives ReadStats while a MAF file is being read. All calls are made
+** from the thread which called ReadMafFile.
+*/
+class ReadStatsSink
+{
+    public:
+        virtual ~ReadStatsSink()
+        { }
+
+        /*
+        ** Called every ReadOptions::progress_interval seconds, as long
+        ** as blocks keep coming in.
+        */
+        virtual void progress(const ReadStats &)
+        { }
+        /*
+        ** Called once all blocks have been added and the storage has been
+        ** prepared. Not called if reading fails.
+        */
+        virtual void finished(const ReadStats &)
+        { }
+};
+
+// Default of ReadOptions::min_score, letting all blocks through.
+const double kNoMinScore = -std::numeric_limits<double>::max();
+
+/*
+** Settings controlling how a MAF file is read. The defaults match the
+** behavior of the plain ReadMafFile overloads.
+*/
+struct ReadOptions
+{
+    ReadOptions():
+        limit(NULL), intervals(NULL), min_score(kNoMinScore),
+        min_reference_length(0), min_informants(0), threads(1),
+        stats(NULL), progress_interval(1.0)
+    { }
+
+    // Specifies which sequences (including reference) should be taken
+    // into consideration, ignoring the rest. NULL means all of them.
+    const std::set<std::string> *limit;
+
+    // Inclusive intervals on the forward strand of the reference. Blocks
+    // whose reference row does not overlap any of them are skipped
+    // without parsing their other rows, as are blocks without the
+    // reference. NULL means all blocks are read.
+    const std::vector<std::pair<size_t, size_t> > *intervals;
+
+    // The following drop blocks before their rows are parsed. Blocks
+    // whose "a" line has a score below min_score are skipped; those
+    // without a score are kept. Blocks whose reference row covers fewer
+    // than min_reference_length nucleotides are skipped, as are blocks
+    // without the reference if this is set. Blocks with fewer than
+    // min_informants rows besides the reference, counting only sequences
+    // allowed by limit, are skipped.
+    double min_score;
+    size_t min_reference_length;
+    size_t min_informants;
+
+    // Number of threads parsing blocks and building their BitSequences,
+    // also used to prepare the storage when stats are gathered.
+    // Sequence IDs are assigned in input order regardless of this value.
+    size_t threads;
+
+    // Receives statistics about the read, NULL means none are gathered.
+    // When set, the storage of the alignment is prepared right after the
+    // blocks have been read, so that its cost can be reported as well.
+    ReadStatsSink *stats;
+    // Seconds between calls to ReadStatsSink::progress.
+    double progress_interval;
+};
+
 /*
 ** Reads a MAF file from stream s and fills WholeGenomeAlignment wga with
 ** its contents. factory specifies the implementation of BitSequence to be
@@ -37,10 +144,81 @@ void ReadMafFile(std::istream &s, WholeGenomeAlignment &wga,
 ** BitSequence to be used and the optional limit parameter specifies which
 ** sequences (including reference) should be taken into consideration,
 ** ignoring the rest.
+**
+** The file is memory mapped and parsed in place, which is considerably
+** faster than going through a stream. gzip compressed files are
+** recognized by their contents and decompressed on the fly; BGZF files
+** are decompressed using as many threads as ReadOptions::threads.
+**
+** Throws FileMappingError if the file can't be opened and
+** DecompressionError if it is compressed and corrupt.
 */
 void ReadMafFile(const std::string &file_name, WholeGenomeAlignment &wga,
         BitSequenceFactory &factory, const std::set<std::string> *limit=NULL);
 
+/*
+** Variants of the above taking a full set of ReadOptions. With more than
+** one thread, an uncompressed file is split at paragraph boundaries and
+** the blocks are parsed concurrently. Streams and compressed files are
+** read through a pipeline instead, where a reader thread, tokenizer
+** threads and BitSequence builder threads work on different batches of
+** paragraphs at the same time, connected by bounded queues.
+*/
+void ReadMafFile(std::istream &s, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const ReadOptions &options);
+void ReadMafFile(const std::string &file_name, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const ReadOptions &options);
+
+/*
+** Reads several MAF files, such as the per-chromosome files of a UCSC
+** alignment, into wga. With more than one thread, whole files are parsed
+** concurrently, one per thread, while the calling thread merges them into
+** wga. Blocks are added and sequence IDs assigned in the order of files,
+** so the result does not depend on the number of threads. Files without
+** the reference of wga are scanned, but none of their blocks is parsed.
+**
+** Throws the same exceptions as ReadMafFile.
+*/
+void ReadMafFiles(const std::vector<std::string> &file_names,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory,
+        const ReadOptions &options);
+
+/*
+** Returns the paths of all files in directory whose names end in .maf or
+** .maf.gz, sorted by name.
+**
+** Throws FileMappingError if the directory can't be read.
+*/
+std::vector<std::string> ListMafFiles(const std::string &directory);
+
+/*
+** Builds an alignment index file, as read by MappedAlignment, straight
+** from a MAF file without ever holding the whole alignment in memory.
+** Blocks are converted as they are read and collected until they take up
+** half of memory_budget bytes, at which point they are sorted and spilled
+** to a temporary file next to output. The sorted runs are merged into the
+** index in the end, each read through a buffer taking its share of the
+** other half of the budget. Blocks without the reference are left out;
+** options.limit and the block filters apply as in ReadMafFile, threads
+** are only used to decompress BGZF input.
+**
+** Throws the same exceptions as ReadMafFile, and SnapshotError if the
+** temporary files or the index can't be written.
+*/
+void BuildMappedAlignment(const std::string &file_name,
+        const std::string &reference, const std::string &output,
+        size_t memory_budget, const ReadOptions &options);
+
+/*
+** Parses the first block found between begin and end, which is typically
+** a single paragraph located using a MafIndex, assigning sequence IDs
+** through wga. Unlike ReadMafFile, the block is returned to the caller
+** instead of being added to wga.
+**
+** Throws ParseError if there is no valid block.
+*/
+AlignmentBlock * ReadMafBlock(const char *begin, const char *end,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory);
 
 } /* namespace maf_reader */
 
@@ -0,0 +1,230 @@
+#ifndef MAPPEDALIGNMENT_H
+#define MAPPEDALIGNMENT_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <MappedFile.h>
+#include <MultialnConstants.h>
+
+
+class WholeGenomeAlignment;
+
+/*
+** Layout of alignment index files. Everything is stored in flat arrays
+** addressed by offsets from the beginning of the file, so that the file
+** can be queried directly from a read-only memory mapping. All sections
+** start at a multiple of 8 bytes.
+**
+**   Header
+**   uint64_t block_starts[block_count]      sorted reference starts
+**   uint64_t block_rows[block_count + 1]    first row of each block
+**   Row rows[row_count]                     sorted by ID within a block
+**   uint64_t bits[word_count]               all rows, each starting at
+**                                           a word boundary
+**   uint64_t rank_samples[word_count / 8 + 1]
+**                                           number of ones preceding every
+**                                           group of 8 words
+**   Sequence sequences[sequence_count]      sorted by name
+**   char names[]
+*/
+namespace mapped_format
+{
+
+const uint64_t kMagic = 0x3158444e494c414dULL;
+const uint32_t kVersion = 1;
+
+struct Header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t sequence_count, block_count, row_count, word_count;
+    uint64_t reference_size;
+    uint64_t block_starts_offset, block_rows_offset, rows_offset,
+             bits_offset, rank_samples_offset, sequences_offset,
+             names_offset, file_size;
+};
+
+struct Row
+{
+    // Position of the first nucleotide and size of the source sequence,
+    // exactly as in SequenceDetails.
+    uint64_t start, src_size;
+    // Index of the first word of this row in the bits section.
+    uint64_t first_word;
+    uint32_t length, ones;
+    uint16_t id;
+    uint8_t reverse;
+    uint8_t padding[5];
+};
+
+struct Sequence
+{
+    uint64_t name_offset, name_length, size;
+    uint16_t id;
+    uint8_t padding[6];
+};
+
+} /* namespace mapped_format */
+
+/*
+** Writes an alignment index file one block at a time. The number of
+** blocks, rows and words has to be known up front, since each section
+** is written directly to its final place in the file.
+*/
+class MappedAlignmentWriter
+{
+    public:
+        MappedAlignmentWriter(const std::string &file_name,
+                size_t block_count, size_t row_count, size_t word_count);
+        ~MappedAlignmentWriter();
+
+        void addSequence(seqid_t id, const std::string &name, size_t size);
+        /*
+        ** Adds all sequences known to wga, with their IDs.
+        */
+        void addSequences(const WholeGenomeAlignment &wga);
+
+        /*
+        ** Starts a new block. Blocks have to be added in the order of
+        ** their starting positions on the reference.
+        */
+        void beginBlock(size_t reference_start);
+        /*
+        ** Adds a row to the current block. Rows have to be added in the
+        ** order of their IDs. words holds (length + 63) / 64 words, with
+        ** the bit for column i at bit i % 64 of word i / 64. Throws
+        ** SnapshotError if the row is too long for the format.
+        */
+        void addRow(seqid_t id, size_t start, bool reverse, size_t src_size,
+                size_t length, const uint64_t *words);
+
+        /*
+        ** Writes the sequence table and the header. Throws SnapshotError
+        ** if fewer or more blocks, rows or words have been added than
+        ** announced.
+        */
+        void finish();
+
+        /*
+        ** Returns the number of words a row of the given length occupies.
+        */
+        static size_t wordsForLength(size_t length)
+        {
+            return (length + 63) / 64;
+        }
+
+    private:
+        // Buffers writes to one section of the file.
+        class Section
+        {
+            public:
+                Section(int fd, uint64_t offset);
+                ~Section();
+                void write(const void *data, size_t length);
+                void flush();
+
+            private:
+                int fd_;
+                uint64_t offset_;
+                std::vector<char> buffer_;
+        };
+
+        int fd_;
+        mapped_format::Header header_;
+        Section *block_starts_, *block_rows_, *rows_, *bits_,
+                *rank_samples_;
+        uint64_t blocks_added_, rows_added_, words_added_, ones_added_;
+        std::vector<mapped_format::Sequence> sequences_;
+        std::string names_;
+
+        // The following are forbidden.
+        MappedAlignmentWriter(const MappedAlignmentWriter &);
+        MappedAlignmentWriter & operator=(const MappedAlignmentWriter &);
+};
+
+/*
+** Writes all blocks of wga into an alignment index file.
+*/
+void WriteMappedAlignment(WholeGenomeAlignment &wga,
+        const std::string &file_name);
+
+/*
+** Read-only alignment served directly from a memory mapped index file.
+** Nothing is copied to the heap; queries only touch the pages they need,
+** and processes mapping the same file share a single copy of it in the
+** page cache.
+*/
+class MappedAlignment
+{
+    public:
+        /*
+        ** Throws FileMappingError if the file can't be mapped and
+        ** SnapshotError if its header is not a valid one. Only the header
+        ** is checked up front; queries throw SnapshotError when they come
+        ** across an entry pointing outside of its section.
+        */
+        explicit MappedAlignment(const std::string &file_name);
+
+        /*
+        ** Same semantics as WholeGenomeAlignment::mapPositionToInformant.
+        */
+        size_t mapPositionToInformant(size_t position,
+                const std::string &informant,
+                IntervalBoundary boundary=INTERVAL_BEGIN) const;
+
+        /*
+        ** Returns the ID of the specified sequence, throws
+        ** SequenceDoesNotExist if there is no such sequence.
+        */
+        seqid_t getSequenceId(const std::string &name) const;
+
+        size_t getReferenceSize() const
+        {
+            return this->header_->reference_size;
+        }
+        size_t countBlocks() const
+        {
+            return this->header_->block_count;
+        }
+
+    private:
+        MappedFile file_;
+        const mapped_format::Header *header_;
+        const uint64_t *block_starts_, *block_rows_;
+        const mapped_format::Row *rows_;
+        const uint64_t *bits_, *rank_samples_;
+        const mapped_format::Sequence *sequences_;
+        const char *names_;
+
+        // Throws SnapshotError unless all sections lie within the file,
+        // in order. Only reads the header.
+        void checkSections() const;
+        // The following throw SnapshotError unless the bits or the name
+        // the entry refers to lie within their section, and return the
+        // entry otherwise. Queries check each entry they use, so that
+        // none of them reads outside of the mapping, without opening the
+        // file having to read all of them.
+        const mapped_format::Row & checkRow(
+                const mapped_format::Row &row) const;
+        const mapped_format::Sequence & checkSequence(
+                const mapped_format::Sequence &sequence) const;
+
+        const mapped_format::Row * findRow(size_t block, seqid_t id) const;
+        // Number of ones among the first count bits of row.
+        size_t rank(const mapped_format::Row &row, size_t count) const;
+        // Position of the index-th one (counted from 1) of row.
+        size_t select(const mapped_format::Row &row, size_t index) const;
+        size_t sequenceToAlignment(const mapped_format::Row &row,
+                size_t index) const;
+        size_t alignmentToSequence(const mapped_format::Row &row,
+                size_t index, IntervalBoundary boundary) const;
+
+        // The following are forbidden.
+        MappedAlignment(const MappedAlignment &);
+        MappedAlignment & operator=(const MappedAlignment &);
+};
+
+#endif /* MAPPEDALIGNMENT_H */
@@ -0,0 +1,64 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <exception>
+
+
+class FileMappingError: public std::exception
+{
+    public:
+        FileMappingError() throw(): exception() {};
+        FileMappingError(const FileMappingError &other) throw():
+            exception(other)
+        { }
+};
+
+/*
+** Read-only memory mapping of a whole file. The contents stay mapped for
+** the lifetime of the instance.
+**
+** Throws FileMappingError in case the file can't be opened or mapped.
+*/
+class MappedFile
+{
+    public:
+        // Tells the kernel how the contents are going to be accessed, so
+        // it can pick a suitable read-ahead strategy.
+        enum AccessPattern {
+            ACCESS_SEQUENTIAL,
+            ACCESS_RANDOM,
+        };
+
+        explicit MappedFile(const std::string &file_name,
+                AccessPattern pattern=ACCESS_SEQUENTIAL);
+        ~MappedFile();
+
+        /*
+        ** Returns a pointer to the first byte of the file. The contents
+        ** are not null-terminated; use size() to find the end. May be NULL
+        ** if the file is empty.
+        */
+        const char * data() const
+        {
+            return this->data_;
+        }
+        size_t size() const
+        {
+            return this->size_;
+        }
+        const char * end() const
+        {
+            return this->data_ + this->size_;
+        }
+
+    private:
+        const char *data_;
+        size_t size_;
+
+        // The following are forbidden.
+        MappedFile(const MappedFile &);
+        MappedFile & operator=(const MappedFile &);
+};
+
+#endif /* MAPPEDFILE_H */
@@ -0,0 +1,69 @@
+#ifndef OVERLAPALIGNMENTBLOCKSTORAGE_H
+#define OVERLAPALIGNMENTBLOCKSTORAGE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <AlignmentBlock.h>
+#include <VectorAlignmentBlockStorage.h>
+
+
+/*
+** Implementation of AlignmentBlockStorage for alignments whose blocks
+** overlap on the reference, as in pairwise or unfiltered MAFs. Besides
+** the usual lookup by start, findAll returns every block covering
+** a position, and getBlock returns the one starting last among them, so
+** positions covered only by an earlier, longer block are still found.
+**
+** The sorted blocks are laid out as an implicit interval tree: the
+** element in the middle of each range is the root of its subtree and
+** knows the largest end within it. A query descends only into subtrees
+** reaching pos, which makes it take O(log n + k) time for k blocks found.
+**
+** The tree is built lazily, i. e. the first time a lookup is performed.
+*/
+class OverlapAlignmentBlockStorage: public VectorAlignmentBlockStorage
+{
+    public:
+        OverlapAlignmentBlockStorage():
+            root_level_(0)
+        { }
+
+        virtual AlignmentBlock * getBlock(const size_t pos);
+        virtual AlignmentBlock * getBlockNear(const size_t pos,
+                QueryCursor &cursor);
+
+        /*
+        ** Replaces the contents of blocks with all blocks covering pos
+        ** on the reference, ordered by their start. Returns their number,
+        ** which is zero if pos is not covered at all.
+        */
+        size_t findAll(const size_t pos,
+                std::vector<AlignmentBlock *> &blocks);
+
+    protected:
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
+        {
+            return "overlap";
+        }
+        virtual void buildIndex();
+        virtual void dropIndex();
+
+    private:
+        // Reference starts of contents_ and the positions just past their
+        // ends.
+        std::vector<size_t> starts_, ends_;
+        // The largest end within the subtree rooted at each element.
+        std::vector<size_t> max_ends_;
+        // Level of the root; leaves are at level 0.
+        unsigned root_level_;
+
+        // Appends the blocks covering pos to blocks, unless it is NULL,
+        // and stores the index of the last one in last. Returns their
+        // number.
+        size_t visitCovering(const size_t pos,
+                std::vector<AlignmentBlock *> *blocks, size_t &last) const;
+};
+
+#endif /* OVERLAPALIGNMENTBLOCKSTORAGE_H */
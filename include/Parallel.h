@@ -0,0 +1,37 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+
+// Ranges handed out by SplitRanges and ForEachRange don't get any
+// shorter, unless there is just one.
+const size_t kMinRangeLength = 4096;
+
+/*
+** Runs task(i) for each i below count, each in a thread of its own unless
+** there is only one, and waits for all of them. Rethrows the exception of
+** the first task which has thrown.
+*/
+void RunTasks(size_t count, const std::function<void (size_t)> &task);
+
+/*
+** Returns the boundaries, including both ends, of at most threads
+** consecutive ranges of similar length covering [0, count), none shorter
+** than min_length unless there is only one. The result only depends on
+** the arguments.
+*/
+std::vector<size_t> SplitRanges(size_t count, size_t threads,
+        size_t min_length = kMinRangeLength);
+
+/*
+** Splits [0, count) using SplitRanges and calls work(begin, end) on each
+** of the ranges using RunTasks.
+*/
+void ForEachRange(size_t count, size_t threads,
+        const std::function<void (size_t, size_t)> &work,
+        size_t min_length = kMinRangeLength);
+
+#endif /* PARALLEL_H */
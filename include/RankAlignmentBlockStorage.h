@@ -1,10 +1,8 @@
 #ifndef RANKALIGNMENTBLOCKSTORAGE_H
 #define RANKALIGNMENTBLOCKSTORAGE_H
 
-#include <vector>
-
 #include <AlignmentBlock.h>
-#include <AlignmentBlockStorage.h>
+#include <VectorAlignmentBlockStorage.h>
 
 
 namespace cds_static
@@ -12,85 +10,42 @@ namespace cds_static
 class BitSequence;
 }
 
-// TODO: Factor out the common parts with BinSearchAlignmentBlockStorage
-// into something like an abstract VectorAlignmentBlockStorage
-
-// forward declaration
-class RankAlignmentBlockStorageIteratorImplementation;
-
 /*
 ** Implementation of AlignmentBlockStorage which stores the blocks in a
-** sorted vector and ises binary search to find the right block.
+** sorted vector and uses rank on an RRR BitSequence marking the starting
+** positions of blocks on the reference to find the right block.
 **
-** The sorting is handled lazily, i. e. the list is sorted the first time
-** a find operation is performed.
+** The bitmap is built from the sorted starts and only spans the positions
+** from the first start to the last one, whatever the length of the
+** reference. Given more threads, prepare collects the starts
+** concurrently; the RRR construction itself is sequential.
+**
+** The sorting and the construction of the BitSequence are handled lazily,
+** i. e. the first time a find operation is performed.
 */
-class RankAlignmentBlockStorage: public AlignmentBlockStorage
+class RankAlignmentBlockStorage: public VectorAlignmentBlockStorage
 {
     public:
-        typedef std::vector<AlignmentBlock *> Container;
-
         RankAlignmentBlockStorage():
-            prepared_(false), index_(NULL)
+            index_(NULL), base_(0)
         { }
         virtual ~RankAlignmentBlockStorage();
-        virtual void addBlock(AlignmentBlock *block);
-        virtual iterator find(const size_t pos);
-        virtual iterator begin();
-        virtual iterator end();
-        virtual size_t size() const;
-
-    private:
-        typedef RankAlignmentBlockStorageIteratorImplementation
-            IteratorImplementation;
-        Container contents_;
-        bool prepared_;
-        cds_static::BitSequence *index_;
-        void unprepare();
-        void prepare();
-};
-
-class RankAlignmentBlockStorageIteratorImplementation:
-    public AlignmentBlockStorageIteratorImplementation
-{
-    public:
-        RankAlignmentBlockStorageIteratorImplementation(
-                const RankAlignmentBlockStorageIteratorImplementation &other):
-            current_(other.current_)
-        { }
-        RankAlignmentBlockStorageIteratorImplementation(
-                const RankAlignmentBlockStorage::Container::iterator &it):
-            current_(it)
-        { }
-        virtual RankAlignmentBlockStorageIteratorImplementation * clone() const
-        {
-            return new RankAlignmentBlockStorageIteratorImplementation(*this);
-        }
-        virtual reference operator*() const
-        {
-            return **(this->current_);
-        }
-        virtual pointer operator->() const
-        {
-            return *(this->current_);
-        }
-        virtual RankAlignmentBlockStorageIteratorImplementation& operator++()
-        {
-            ++(this->current_);
-            return *this;
-        }
 
     protected:
-        virtual bool equal(
-                const AlignmentBlockStorageIteratorImplementation &other) const
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
         {
-            const RankAlignmentBlockStorageIteratorImplementation &other2 =
-                static_cast<const RankAlignmentBlockStorageIteratorImplementation&>(other);
-            return other2.current_ == this->current_;
+            return "rank";
         }
+        virtual void saveIndex(std::ofstream &fp);
+        virtual void loadIndex(std::ifstream &fp);
+        virtual void buildIndex();
+        virtual void dropIndex();
 
     private:
-        RankAlignmentBlockStorage::Container::iterator current_;
+        // Bit i is set if a block starts at base_ + i.
+        cds_static::BitSequence *index_;
+        size_t base_;
 };
 
 #endif /* RANKALIGNMENTBLOCKSTORAGE_H */
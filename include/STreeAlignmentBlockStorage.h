@@ -0,0 +1,74 @@
+#ifndef STREEALIGNMENTBLOCKSTORAGE_H
+#define STREEALIGNMENTBLOCKSTORAGE_H
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include <AlignmentBlock.h>
+#include <VectorAlignmentBlockStorage.h>
+
+
+/*
+** Implementation of AlignmentBlockStorage which builds a static B-tree
+** (S-tree) over the reference starts of the blocks. Each node holds
+** kKeysPerNode starts and takes up exactly one cache line; the children
+** are found by arithmetic rather than pointers. A node is searched by
+** comparing pos with all of its keys at once using AVX2, where
+** available, and counting the keys not greater than pos, so the whole
+** lookup is free of unpredictable branches.
+**
+** The tree is built lazily, i. e. the first time a find operation is
+** performed. Given more threads, prepare fills the subtrees a few levels
+** below the root concurrently.
+*/
+class STreeAlignmentBlockStorage: public VectorAlignmentBlockStorage
+{
+    public:
+        // A node has to fit a cache line.
+        static const size_t kKeysPerNode = 8;
+
+        STreeAlignmentBlockStorage():
+            keys_(NULL), node_count_(0)
+        { }
+        virtual ~STreeAlignmentBlockStorage();
+
+    protected:
+        virtual size_t findIndex(const size_t pos);
+        virtual const char * indexName() const
+        {
+            return "stree";
+        }
+        virtual void buildIndex();
+        virtual void dropIndex();
+
+    private:
+        // node_count_ nodes of kKeysPerNode keys each, aligned to a cache
+        // line. Unused keys are larger than any position.
+        int64_t *keys_;
+        // Index into contents_ of each key, contents_.size() for unused
+        // keys.
+        std::vector<size_t> blocks_;
+        size_t node_count_;
+
+        // Fills the subtree rooted at node with the sorted starts from
+        // next on; returns the first one not used.
+        size_t fill(size_t next, size_t node);
+        // Same as fill, but stops levels levels below node; the roots of
+        // the subtrees left out are added to subtrees, each preceded by
+        // the first start it gets.
+        size_t fillTop(size_t next, size_t node, unsigned levels,
+                std::vector<std::pair<size_t, size_t> > &subtrees);
+        // Fills the given slot with the start next, or with padding if
+        // there are no starts left; returns the next start to use.
+        size_t fillSlot(size_t next, size_t slot);
+        // Number of nodes of the subtree rooted at node.
+        size_t subtreeNodes(size_t node) const;
+
+        // The following are forbidden.
+        STreeAlignmentBlockStorage(const STreeAlignmentBlockStorage &);
+        STreeAlignmentBlockStorage & operator=(
+                const STreeAlignmentBlockStorage &);
+};
+
+#endif /* STREEALIGNMENTBLOCKSTORAGE_H */
@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <exception>
+#include <fstream>
 
 #include <BitSequence.h>
 #include <MultialnConstants.h>
@@ -18,6 +19,15 @@ class OutOfSequence: public std::exception
         { }
 };
 
+class SnapshotError: public std::exception
+{
+    public:
+        SnapshotError() throw(): exception() {};
+        SnapshotError(const SnapshotError &other) throw():
+            exception(other)
+        { }
+};
+
 class SequenceDetails
 {
     public:
@@ -84,6 +94,29 @@ class SequenceDetails
         {
             return this->id_;
         }
+        bool is_reverse() const
+        {
+            return this->reverse_;
+        }
+        /*
+        ** Returns the bit sequence marking which alignment columns are
+        ** filled in this sequence.
+        */
+        const cds_static::BitSequence * get_sequence() const
+        {
+            return this->sequence_.get();
+        }
+
+        /*
+        ** Writes this row, including its BitSequence, to fp. fp has to be
+        ** opened in binary mode.
+        */
+        void save(std::ofstream &fp) const;
+        /*
+        ** Reads a row previously written by save. Throws SnapshotError if
+        ** the data can't be read.
+        */
+        static SequenceDetails load(std::ifstream &fp);
 
         static bool compareById(const SequenceDetails &d1,
                 const SequenceDetails &d2)
@@ -0,0 +1,120 @@
+#ifndef VECTORALIGNMENTBLOCKSTORAGE_H
+#define VECTORALIGNMENTBLOCKSTORAGE_H
+
+#include <vector>
+
+#include <AlignmentBlock.h>
+#include <AlignmentBlockStorage.h>
+#include <Arena.h>
+
+
+/*
+** Common base of the storages which keep their blocks in a vector sorted
+** by the reference position, with a search structure on top of it.
+**
+** Blocks may be added in any order, but adding them in reference order,
+** as they come out of a sorted MAF, is the fast path: addBlock checks the
+** order as it goes and prepare sorts only if it has been violated, then
+** lets the subclass build its search structure in a single pass. The
+** preparation happens lazily the first time the blocks are accessed,
+** unless prepare is called explicitly. Given more threads, prepare sorts
+** and compacts concurrently, and subclasses spread the building of their
+** search structure over threads_ threads using ForEachRange.
+**
+** Once sorted, the rows of the blocks added since the last prepare are
+** moved into a new arena in reference order, so that walking a range
+** touches consecutive memory and tearing the storage down frees them
+** a chunk at a time. The blocks themselves never move, nor do rows
+** compacted before; only row pointers obtained from a block before its
+** first compaction become invalid. The BitSequences are shared, not
+** copied, so copies of the rows stay valid after the storage is gone.
+**
+** Lookups through a QueryCursor gallop from the block found last, in
+** either direction, doubling the step up to kMaxGallop blocks, and fall
+** back to the search structure if pos is even further away.
+*/
+class VectorAlignmentBlockStorage: public AlignmentBlockStorage
+{
+    public:
+        typedef std::vector<AlignmentBlock *> Container;
+
+        // The longest step taken while galloping; beyond it, a search
+        // over the whole index is cheaper.
+        static const size_t kMaxGallop = 256;
+
+        VectorAlignmentBlockStorage():
+            prepared_(false), index_loaded_(false), threads_(1),
+            sorted_(true)
+        { }
+        virtual ~VectorAlignmentBlockStorage();
+        virtual void addBlock(AlignmentBlock *block);
+        virtual iterator find(const size_t pos);
+        virtual AlignmentBlock * getBlockNear(const size_t pos,
+                QueryCursor &cursor);
+        virtual iterator begin();
+        virtual iterator end();
+        virtual size_t size() const;
+        virtual void prepare();
+        virtual void prepare(size_t threads);
+
+    protected:
+        Container contents_;
+        bool prepared_;
+        // Set by loadIndex implementations once their search structure
+        // has been restored, so that prepare doesn't build it again.
+        bool index_loaded_;
+        // Number of threads buildIndex may use, see ForEachRange.
+        size_t threads_;
+
+        /*
+        ** Returns the index into contents_ of the last block starting at
+        ** or before pos, using the search structure. Only called on
+        ** a prepared storage with at least one block.
+        **
+        ** Throws OutOfSequence if there is no such block.
+        */
+        virtual size_t findIndex(const size_t pos) = 0;
+        /*
+        ** Builds the search structure over contents_, which is sorted by
+        ** the time this gets called.
+        */
+        virtual void buildIndex()
+        { }
+        /*
+        ** Drops the search structure, since a block has been added.
+        */
+        virtual void dropIndex()
+        { }
+
+        /*
+        ** Fills starts with the reference starts of contents_, using
+        ** threads_ threads.
+        */
+        void collectStarts(std::vector<size_t> &starts) const;
+
+        virtual AlignmentBlock * blockAt(size_t index)
+        {
+            return this->contents_[index];
+        }
+        virtual AlignmentBlock * const * blockArray()
+        {
+            return this->contents_.empty() ? NULL : &this->contents_[0];
+        }
+
+    private:
+        // Whether contents_ is known to be sorted.
+        bool sorted_;
+        // Hold the rows of the blocks compacted so far.
+        std::vector<Arena *> arenas_;
+        // Blocks added since the last compaction.
+        Container pending_;
+
+        // Moves the rows of the pending blocks into new arenas.
+        void compact();
+
+        // Searches the blocks around hint for the one findIndex would
+        // return; returns false if pos is too far away.
+        bool gallop(const size_t pos, size_t hint, size_t &index) const;
+};
+
+#endif /* VECTORALIGNMENTBLOCKSTORAGE_H */
@@ -5,6 +5,7 @@
 #include <tuple>
 #include <vector>
 #include <map>
+#include <fstream>
 
 #include <AlignmentBlock.h>
 #include <SequenceDetails.h>
@@ -26,6 +27,11 @@ class WholeGenomeAlignment
     public:
         typedef std::map<std::string, size_t> PositionMapping;
 
+        /*
+        ** Takes over storage, which is deleted even if the constructor
+        ** throws, and attaches it to the new alignment. Throws whatever
+        ** AlignmentBlockStorage::attach throws.
+        */
         WholeGenomeAlignment(const std::string &reference,
                 AlignmentBlockStorage * storage);
         ~WholeGenomeAlignment();
@@ -35,6 +41,11 @@ class WholeGenomeAlignment
             return reference_;
         }
 
+        AlignmentBlockStorage * get_storage() const
+        {
+            return storage_;
+        }
+
         void addBlock(AlignmentBlock *block)
         {
             this->storage_->addBlock(block);
@@ -54,6 +65,16 @@ class WholeGenomeAlignment
                 const std::string &informant,
                 IntervalBoundary boundary=INTERVAL_BEGIN) const;
 
+        /*
+        ** Same as above, but looks the block up starting from where the
+        ** last lookup through cursor ended; see QueryCursor. Mapping
+        ** a sorted stream of positions this way costs next to nothing per
+        ** position.
+        */
+        size_t mapPositionToInformant(size_t position,
+                const std::string &informant, QueryCursor &cursor,
+                IntervalBoundary boundary=INTERVAL_BEGIN) const;
+
         /*
         ** Takes a position in the reference sequence and maps it to all
         ** informants possible.
@@ -122,6 +143,24 @@ class WholeGenomeAlignment
         */
         std::vector<std::string> * getSequenceList() const;
 
+        /*
+        ** Writes a snapshot of the whole alignment (sequence names and
+        ** sizes, all blocks and the search structure of the storage) to
+        ** fp, which has to be opened in binary mode.
+        */
+        void save(std::ofstream &fp) const;
+
+        /*
+        ** Recreates an alignment from a snapshot written by save, storing
+        ** its blocks in storage, which is taken over by the alignment (or
+        ** deleted on failure). The sequence IDs are the same as in the
+        ** saved alignment.
+        **
+        ** Throws SnapshotError if fp does not contain a valid snapshot.
+        */
+        static WholeGenomeAlignment * load(std::ifstream &fp,
+                AlignmentBlockStorage *storage);
+
 
     private:
         // This maps sequence IDs to tuples (name, total length).
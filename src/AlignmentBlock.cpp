@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <fstream>
 #include <BitString.h>
 #include <BitSequence.h>
 
@@ -81,6 +82,51 @@ const SequenceDetails * AlignmentBlock::getSequence(seqid_t sequence)
     return &this->sequences_[start];
 }
 
+void AlignmentBlock::save(std::ofstream &fp)
+{
+    this->prepare();
+    cds_utils::saveValue(fp, this->sequences_.size());
+    for (Container::const_iterator it = this->sequences_.begin();
+            it != this->sequences_.end(); ++it)
+    {
+        it->save(fp);
+    }
+}
+
+AlignmentBlock * AlignmentBlock::load(std::ifstream &fp)
+{
+    size_t count = cds_utils::loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    AlignmentBlock *block = new AlignmentBlock();
+    try
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            block->sequences_.push_back(SequenceDetails::load(fp));
+        }
+    }
+    catch (...)
+    {
+        delete block;
+        throw;
+    }
+    // The rows have been saved in their prepared order.
+    block->prepared_ = true;
+    return block;
+}
+
+void AlignmentBlock::compactRows(const RowAllocator &allocator)
+{
+    this->prepare();
+    Container rows(allocator);
+    rows.reserve(this->sequences_.size());
+    rows.assign(this->sequences_.begin(), this->sequences_.end());
+    this->sequences_.swap(rows);
+}
+
 void AlignmentBlock::prepare()
 {
     if (this->prepared_)
@@ -91,6 +137,6 @@ void AlignmentBlock::prepare()
     sort(this->sequences_.begin(), this->sequences_.end(),
             SequenceDetails::compareById);
     // Shrink the vector to its minimal required size.
-    vector<SequenceDetails>(this->sequences_).swap(this->sequences_);
+    Container(this->sequences_).swap(this->sequences_);
     this->prepared_ = true;
 }
@@ -1,6 +1,68 @@
+#include <string>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <BitSequence.h>
+
 #include <AlignmentBlockStorage.h>
 #include <AlignmentBlock.h>
 #include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+typedef std::vector<AlignmentBlock *>::iterator BlockIterator;
+
+// Merges neighbouring sorted runs, given by their boundaries including
+// both ends, pairwise until only one is left. The merges of a round are
+// spread over threads.
+void mergeRuns(std::vector<BlockIterator> &runs, size_t threads)
+{
+    while (runs.size() > 2)
+    {
+        size_t pairs = (runs.size() - 1) / 2;
+        size_t tasks = std::max<size_t>(1, std::min(threads, pairs));
+        RunTasks(tasks, [&runs, pairs, tasks](size_t task)
+        {
+            for (size_t pair = task; pair < pairs; pair += tasks)
+            {
+                std::inplace_merge(runs[2 * pair], runs[2 * pair + 1],
+                        runs[2 * pair + 2],
+                        AlignmentBlock::compareReferencePosition);
+            }
+        });
+
+        std::vector<BlockIterator> merged;
+        size_t i = 0;
+        for (; i + 2 < runs.size(); i += 2)
+        {
+            merged.push_back(runs[i]);
+        }
+        for (; i < runs.size(); ++i)
+        {
+            merged.push_back(runs[i]);
+        }
+        runs.swap(merged);
+    }
+}
+
+// Sorts the blocks from first to last, which usually come in a few
+// sorted runs, one per MAF file, by merging the runs.
+void sortRange(BlockIterator first, BlockIterator last)
+{
+    std::vector<BlockIterator> runs;
+    runs.push_back(first);
+    while (runs.back() != last)
+    {
+        runs.push_back(std::is_sorted_until(runs.back(), last,
+                    AlignmentBlock::compareReferencePosition));
+    }
+    mergeRuns(runs, 1);
+}
+
+} /* namespace */
 
 
 AlignmentBlock * AlignmentBlockStorage::getBlock(const size_t pos)
@@ -12,3 +74,90 @@ AlignmentBlock * AlignmentBlockStorage::getBlock(const size_t pos)
     block->getReferenceSequence()->sequenceToAlignment(pos);
     return block;
 }
+
+AlignmentBlock * AlignmentBlockStorage::getBlockNear(const size_t pos,
+        QueryCursor &)
+{
+    return this->getBlock(pos);
+}
+
+void AlignmentBlockStorage::sortBlocks(std::vector<AlignmentBlock *> &blocks,
+        size_t threads)
+{
+    std::vector<size_t> bounds = SplitRanges(blocks.size(), threads);
+    if (bounds.size() <= 2)
+    {
+        sortRange(blocks.begin(), blocks.end());
+        return;
+    }
+
+    std::vector<BlockIterator> runs;
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        runs.push_back(blocks.begin() + bounds[i]);
+    }
+    RunTasks(runs.size() - 1, [&runs](size_t i)
+    {
+        sortRange(runs[i], runs[i + 1]);
+    });
+    mergeRuns(runs, threads);
+}
+
+void AlignmentBlockStorage::save(std::ofstream &fp)
+{
+    cds_utils::saveValue(fp, this->size());
+    for (iterator it = this->begin(); it != this->end(); ++it)
+    {
+        it->save(fp);
+    }
+
+    // The index is preceded by its name and length so that any other kind
+    // of storage can skip it.
+    std::string name = this->indexName();
+    cds_utils::saveValue(fp, name.size());
+    fp.write(name.data(), name.size());
+    std::streampos length_pos = fp.tellp();
+    cds_utils::saveValue(fp, size_t(0));
+    this->saveIndex(fp);
+    std::streampos end_pos = fp.tellp();
+    fp.seekp(length_pos);
+    cds_utils::saveValue(fp, size_t(end_pos - length_pos) - sizeof(size_t));
+    fp.seekp(end_pos);
+}
+
+void AlignmentBlockStorage::load(std::ifstream &fp)
+{
+    bool was_empty = (this->size() == 0);
+    size_t count = cds_utils::loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        this->addBlock(AlignmentBlock::load(fp));
+    }
+
+    size_t name_length = cds_utils::loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    std::string name(name_length, ' ');
+    fp.read(&name[0], name_length);
+    size_t index_length = cds_utils::loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    std::streampos index_end = fp.tellg() + std::streamoff(index_length);
+    if (was_empty && name == this->indexName())
+    {
+        this->loadIndex(fp);
+    }
+    fp.seekg(index_end);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+}
@@ -0,0 +1,40 @@
+#include <algorithm>
+#include <cstdint>
+
+#include <Arena.h>
+
+
+const size_t Arena::kChunkSize;
+
+Arena::~Arena()
+{
+    for (size_t i = 0; i < this->chunks_.size(); ++i)
+    {
+        ::operator delete(this->chunks_[i]);
+    }
+}
+
+void * Arena::allocate(size_t bytes, size_t alignment)
+{
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(this->current_)
+            % alignment) % alignment;
+    if (this->current_ == NULL || padding + bytes > this->left_)
+    {
+        // Memory from operator new is aligned for any type.
+        size_t size = this->expected_ > 0 ? this->expected_
+            : std::min(kChunkSize, this->size_ > 0 ? this->size_
+                    : kChunkSize);
+        size = std::max(size, bytes);
+        this->chunks_.reserve(this->chunks_.size() + 1);
+        this->expected_ = 0;
+        this->current_ = static_cast<char *>(::operator new(size));
+        this->chunks_.push_back(this->current_);
+        this->left_ = size;
+        this->size_ += size;
+        padding = 0;
+    }
+    void *result = this->current_ + padding;
+    this->current_ += padding + bytes;
+    this->left_ -= padding + bytes;
+    return result;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include <BucketAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+size_t BucketAlignmentBlockStorage::findIndex(const size_t pos)
+{
+    if (pos < this->base_)
+    {
+        throw OutOfSequence();
+    }
+
+    // Past the last bucket, the last block is the one wanted.
+    size_t bucket = std::min((pos - this->base_) >> this->shift_,
+            this->directory_.size() - 2);
+    std::vector<size_t>::const_iterator first = this->starts_.begin()
+        + this->directory_[bucket];
+    std::vector<size_t>::const_iterator last = this->starts_.begin()
+        + this->directory_[bucket + 1];
+    // If no block in the bucket starts at or before pos, the last one of
+    // an earlier bucket does.
+    size_t index = std::upper_bound(first, last, pos) - this->starts_.begin();
+    return index - 1;
+}
+
+void BucketAlignmentBlockStorage::buildIndex()
+{
+    if (this->contents_.empty())
+    {
+        return;
+    }
+
+    this->collectStarts(this->starts_);
+    this->base_ = this->starts_.front();
+
+    // The smallest bucket size leaving no more buckets than blocks.
+    size_t span = this->starts_.back() - this->base_;
+    this->shift_ = 0;
+    while ((span >> this->shift_) >= this->starts_.size())
+    {
+        ++this->shift_;
+    }
+
+    size_t buckets = (span >> this->shift_) + 1;
+    this->directory_.resize(buckets + 1);
+    const std::vector<size_t> &starts = this->starts_;
+    std::vector<size_t> &directory = this->directory_;
+    size_t base = this->base_;
+    unsigned shift = this->shift_;
+    ForEachRange(buckets, this->threads_, [&starts, &directory, base,
+            shift](size_t begin, size_t end)
+    {
+        // The first block of the range of buckets, the rest follow.
+        size_t index = std::lower_bound(starts.begin(), starts.end(),
+                base + (begin << shift)) - starts.begin();
+        for (size_t bucket = begin; bucket < end; ++bucket)
+        {
+            while (((starts[index] - base) >> shift) < bucket)
+            {
+                ++index;
+            }
+            directory[bucket] = index;
+        }
+    });
+    this->directory_[buckets] = this->starts_.size();
+}
+
+void BucketAlignmentBlockStorage::dropIndex()
+{
+    std::vector<size_t>().swap(this->starts_);
+    std::vector<size_t>().swap(this->directory_);
+    this->base_ = 0;
+    this->shift_ = 0;
+}
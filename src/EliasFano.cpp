@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include <EliasFano.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+// Every this many zeros of the high bits, the position is sampled.
+const uint64_t kZeroSample = 256;
+
+inline size_t popcount(uint64_t word)
+{
+    return __builtin_popcountll(word);
+}
+
+// Position of the index-th (counted from 0) set bit of word.
+inline unsigned selectInWord(uint64_t word, size_t index)
+{
+    for (size_t i = 0; i < index; ++i)
+    {
+        word &= word - 1;
+    }
+    return __builtin_ctzll(word);
+}
+
+// The w-th word of the complement of the first length bits of highs.
+inline uint64_t zerosAt(const std::vector<uint64_t> &highs, size_t w,
+        uint64_t length)
+{
+    uint64_t word = ~highs[w];
+    if ((w + 1) * 64 > length)
+    {
+        word &= (uint64_t(1) << (length % 64)) - 1;
+    }
+    return word;
+}
+
+} /* namespace */
+
+void EliasFano::reset(size_t count, uint64_t max_value)
+{
+    this->count_ = count;
+    this->added_ = 0;
+    this->low_bits_ = 0;
+    while (this->low_bits_ < 63 && count > 0
+            && (max_value >> (this->low_bits_ + 1)) >= count)
+    {
+        ++this->low_bits_;
+    }
+    this->max_high_ = max_value >> this->low_bits_;
+
+    this->lows_.assign((count * this->low_bits_ + 63) / 64 + 1, 0);
+    this->highs_.assign((count + this->max_high_ + 1 + 63) / 64, 0);
+    this->zero_samples_.clear();
+}
+
+void EliasFano::push_back(uint64_t value)
+{
+    size_t index = this->added_++;
+    this->setLow(index, value);
+    uint64_t bit = (value >> this->low_bits_) + index;
+    this->highs_[bit / 64] |= uint64_t(1) << (bit % 64);
+}
+
+void EliasFano::finish()
+{
+    this->sampleZeros(1);
+}
+
+void EliasFano::assign(const std::vector<size_t> &values, size_t threads)
+{
+    size_t count = values.size();
+    this->reset(count, count > 0 ? values.back() : 0);
+    this->added_ = count;
+
+    // Ranges made of whole groups of 64 values start their low bits at a
+    // word boundary, so they never share a word of lows_. The high bits of
+    // neighbouring ranges may share the word at either end of a range;
+    // these are set once all ranges are done.
+    std::vector<std::pair<size_t, uint64_t> > edges;
+    std::mutex mutex;
+    ForEachRange((count + 63) / 64, threads, [this, &values, &edges, &mutex,
+            count](size_t begin, size_t end)
+    {
+        size_t first = begin * 64, last = std::min(count, end * 64);
+        if (first == last)
+        {
+            return;
+        }
+        for (size_t i = first; i < last; ++i)
+        {
+            this->setLow(i, values[i]);
+        }
+
+        std::vector<std::pair<size_t, uint64_t> > range_edges;
+        size_t first_word = ((values[first] >> this->low_bits_) + first) / 64;
+        size_t current = first_word;
+        uint64_t word = 0;
+        for (size_t i = first; i < last; ++i)
+        {
+            uint64_t bit = (values[i] >> this->low_bits_) + i;
+            if (bit / 64 != current)
+            {
+                if (current == first_word)
+                {
+                    range_edges.push_back(std::make_pair(current, word));
+                }
+                else
+                {
+                    this->highs_[current] = word;
+                }
+                current = bit / 64;
+                word = 0;
+            }
+            word |= uint64_t(1) << (bit % 64);
+        }
+        range_edges.push_back(std::make_pair(current, word));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        edges.insert(edges.end(), range_edges.begin(), range_edges.end());
+    }, kMinRangeLength / 64);
+    for (auto it = edges.begin(); it != edges.end(); ++it)
+    {
+        this->highs_[it->first] |= it->second;
+    }
+
+    this->sampleZeros(threads);
+}
+
+void EliasFano::setLow(size_t index, uint64_t value)
+{
+    if (this->low_bits_ > 0)
+    {
+        uint64_t low = value & ((uint64_t(1) << this->low_bits_) - 1);
+        size_t bit = index * this->low_bits_;
+        this->lows_[bit / 64] |= low << (bit % 64);
+        if (bit % 64 + this->low_bits_ > 64)
+        {
+            this->lows_[bit / 64 + 1] |= low >> (64 - bit % 64);
+        }
+    }
+}
+
+void EliasFano::sampleZeros(size_t threads)
+{
+    uint64_t length = this->count_ + this->max_high_ + 1;
+    const std::vector<uint64_t> &highs = this->highs_;
+    std::vector<size_t> bounds = SplitRanges((length + 63) / 64, threads);
+    size_t parts = bounds.size() - 1;
+
+    // The zeros of each range of words are counted first, so that each
+    // range knows which samples fall into it.
+    std::vector<uint64_t> zeros_before(parts + 1, 0);
+    RunTasks(parts, [&highs, &bounds, &zeros_before, length](size_t part)
+    {
+        uint64_t zeros = 0;
+        for (size_t w = bounds[part]; w < bounds[part + 1]; ++w)
+        {
+            zeros += popcount(zerosAt(highs, w, length));
+        }
+        zeros_before[part + 1] = zeros;
+    });
+    for (size_t part = 0; part < parts; ++part)
+    {
+        zeros_before[part + 1] += zeros_before[part];
+    }
+
+    std::vector<uint64_t> &samples = this->zero_samples_;
+    samples.assign((zeros_before[parts] + kZeroSample - 1) / kZeroSample,
+            0);
+    RunTasks(parts, [&highs, &bounds, &zeros_before, &samples,
+            length](size_t part)
+    {
+        uint64_t zeros = zeros_before[part];
+        size_t sample = (zeros + kZeroSample - 1) / kZeroSample;
+        for (size_t w = bounds[part]; w < bounds[part + 1]; ++w)
+        {
+            uint64_t word = zerosAt(highs, w, length);
+            size_t in_word = popcount(word);
+            // Sample the zeros which fall into this word.
+            while (sample * kZeroSample < zeros + in_word)
+            {
+                samples[sample] = w * 64
+                    + selectInWord(word, sample * kZeroSample - zeros);
+                ++sample;
+            }
+            zeros += in_word;
+        }
+    });
+}
+
+uint64_t EliasFano::low(size_t index) const
+{
+    if (this->low_bits_ == 0)
+    {
+        return 0;
+    }
+    size_t bit = index * this->low_bits_;
+    uint64_t value = this->lows_[bit / 64] >> (bit % 64);
+    if (bit % 64 + this->low_bits_ > 64)
+    {
+        value |= this->lows_[bit / 64 + 1] << (64 - bit % 64);
+    }
+    return value & ((uint64_t(1) << this->low_bits_) - 1);
+}
+
+uint64_t EliasFano::select0(uint64_t index) const
+{
+    uint64_t position = this->zero_samples_[index / kZeroSample];
+    uint64_t remaining = index % kZeroSample;
+    size_t w = position / 64;
+    uint64_t word = ~this->highs_[w] & (~uint64_t(0) << (position % 64));
+    while (true)
+    {
+        size_t zeros = popcount(word);
+        if (remaining < zeros)
+        {
+            return w * 64 + selectInWord(word, remaining);
+        }
+        remaining -= zeros;
+        word = ~this->highs_[++w];
+    }
+}
+
+size_t EliasFano::rank(uint64_t value) const
+{
+    if (this->count_ == 0)
+    {
+        return 0;
+    }
+    uint64_t high = value >> this->low_bits_;
+    if (high > this->max_high_)
+    {
+        return this->count_;
+    }
+    uint64_t low = value & ((uint64_t(1) << this->low_bits_) - 1);
+
+    // Values with a lower high part all precede the (high - 1)-th zero.
+    uint64_t position = 0;
+    size_t index = 0;
+    if (high > 0)
+    {
+        position = this->select0(high - 1) + 1;
+        index = position - high;
+    }
+    // Go through the values sharing the high part, each of them a one
+    // before the next zero.
+    while ((this->highs_[position / 64] >> (position % 64)) & 1)
+    {
+        if (this->low(index) > low)
+        {
+            break;
+        }
+        ++index;
+        ++position;
+    }
+    return index;
+}
+
+size_t EliasFano::getSize() const
+{
+    return sizeof(*this) + sizeof(uint64_t) * (this->lows_.capacity()
+            + this->highs_.capacity() + this->zero_samples_.capacity());
+}
@@ -0,0 +1,34 @@
+#include <vector>
+
+#include <EliasFanoAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+
+
+size_t EliasFanoAlignmentBlockStorage::findIndex(const size_t pos)
+{
+    size_t index = this->starts_.rank(pos);
+    if (index == 0)
+    {
+        throw OutOfSequence();
+    }
+    return index - 1;
+}
+
+void EliasFanoAlignmentBlockStorage::buildIndex()
+{
+    if (this->contents_.empty())
+    {
+        return;
+    }
+    // The starts are sorted, so the last one bounds the universe of the
+    // encoding, whatever the length of the reference.
+    std::vector<size_t> starts;
+    this->collectStarts(starts);
+    this->starts_.assign(starts, this->threads_);
+}
+
+void EliasFanoAlignmentBlockStorage::dropIndex()
+{
+    this->starts_ = EliasFano();
+}
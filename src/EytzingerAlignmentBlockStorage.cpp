@@ -0,0 +1,119 @@
+#include <algorithm>
+
+#include <EytzingerAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+// Number of starts sharing a cache line; prefetching node * this brings
+// in the descendants four levels down.
+const size_t kStartsPerCacheLine = 64 / sizeof(uint64_t);
+
+} /* namespace */
+
+size_t EytzingerAlignmentBlockStorage::findIndex(const size_t pos)
+{
+    const uint64_t *starts = &this->starts_[0];
+    size_t count = this->contents_.size();
+    // Find the first start greater than pos.
+    size_t node = 1;
+    while (node <= count)
+    {
+        __builtin_prefetch(starts + node * kStartsPerCacheLine);
+        node = 2 * node + (starts[node] <= pos);
+    }
+    // Climb back up to the last node where the search went left.
+    node >>= __builtin_ffsll(~node);
+
+    // The block preceding the one found, or the last one if none is
+    // greater.
+    size_t index = (node == 0) ? count : this->blocks_[node];
+    if (index == 0)
+    {
+        throw OutOfSequence();
+    }
+    return index - 1;
+}
+
+void EytzingerAlignmentBlockStorage::buildIndex()
+{
+    size_t count = this->contents_.size();
+    this->starts_.resize(count + 1);
+    this->blocks_.resize(count + 1);
+
+    // The subtrees are filled concurrently, at least eight of them per
+    // thread so that their uneven sizes even out. A single thread fills
+    // the whole tree as one subtree.
+    unsigned levels = 0;
+    while (this->threads_ > 1 && (size_t(1) << levels) < 8 * this->threads_)
+    {
+        ++levels;
+    }
+    std::vector<std::pair<size_t, size_t> > subtrees;
+    this->fillTop(0, 1, levels, subtrees);
+    ForEachRange(subtrees.size(), this->threads_,
+            [this, &subtrees](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            this->fill(subtrees[i].first, subtrees[i].second);
+        }
+    }, kMinRangeLength * subtrees.size() / std::max<size_t>(1, count));
+}
+
+void EytzingerAlignmentBlockStorage::dropIndex()
+{
+    std::vector<uint64_t>().swap(this->starts_);
+    std::vector<size_t>().swap(this->blocks_);
+}
+
+size_t EytzingerAlignmentBlockStorage::fill(size_t next, size_t node)
+{
+    // The in-order walk of the implicit tree visits the nodes in sorted
+    // order. The depth is logarithmic, so recursion is fine.
+    if (node < this->starts_.size())
+    {
+        next = this->fill(next, 2 * node);
+        this->starts_[node] =
+            this->contents_[next]->getReferenceSequence()->get_start();
+        this->blocks_[node] = next;
+        next = this->fill(next + 1, 2 * node + 1);
+    }
+    return next;
+}
+
+size_t EytzingerAlignmentBlockStorage::fillTop(size_t next, size_t node,
+        unsigned levels, std::vector<std::pair<size_t, size_t> > &subtrees)
+{
+    if (node >= this->starts_.size())
+    {
+        return next;
+    }
+    if (levels == 0)
+    {
+        subtrees.push_back(std::make_pair(next, node));
+        return next + this->subtreeSize(node);
+    }
+    next = this->fillTop(next, 2 * node, levels - 1, subtrees);
+    this->starts_[node] =
+        this->contents_[next]->getReferenceSequence()->get_start();
+    this->blocks_[node] = next;
+    return this->fillTop(next + 1, 2 * node + 1, levels - 1, subtrees);
+}
+
+size_t EytzingerAlignmentBlockStorage::subtreeSize(size_t node) const
+{
+    // Every level of the subtree is a contiguous range of nodes, only the
+    // last one may be cut short.
+    size_t nodes = this->starts_.size(), size = 0;
+    for (size_t first = node, last = node; first < nodes;
+            first = 2 * first, last = 2 * last + 1)
+    {
+        size += std::min(last, nodes - 1) - first + 1;
+    }
+    return size;
+}
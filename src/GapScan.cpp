@@ -0,0 +1,131 @@
+#include <cstddef>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GAPSCAN_X86
+#include <immintrin.h>
+#endif
+
+#include <BitString.h>
+
+#include <GapScan.h>
+
+
+namespace
+{
+
+// BitString stores its bits in 32-bit words, least significant bit
+// first, which is exactly the order movemask produces them in.
+typedef void (*GapScanKernel)(const char *text, size_t length,
+        uint32_t *words);
+
+/*
+** Handles the columns starting at done, which has to be a multiple of 32,
+** one at a time.
+*/
+void scanTail(const char *text, size_t length, uint32_t *words, size_t done)
+{
+    if (done == length)
+    {
+        return;
+    }
+    uint32_t word = 0;
+    for (size_t i = done; i < length; ++i)
+    {
+        word |= uint32_t(text[i] != '-') << (i % 32);
+    }
+    words[done / 32] = word;
+}
+
+void scanScalar(const char *text, size_t length, uint32_t *words)
+{
+    size_t full = length / 32 * 32;
+    for (size_t i = 0; i < full; i += 32)
+    {
+        uint32_t word = 0;
+        for (size_t j = 0; j < 32; ++j)
+        {
+            word |= uint32_t(text[i + j] != '-') << j;
+        }
+        words[i / 32] = word;
+    }
+    scanTail(text, length, words, full);
+}
+
+#ifdef GAPSCAN_X86
+
+__attribute__((target("sse2")))
+void scanSSE2(const char *text, size_t length, uint32_t *words)
+{
+    const __m128i gap = _mm_set1_epi8('-');
+    size_t full = length / 32 * 32;
+    for (size_t i = 0; i < full; i += 32)
+    {
+        __m128i low = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(text + i));
+        __m128i high = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(text + i + 16));
+        uint32_t gaps =
+            uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(low, gap)))
+            | (uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(high, gap))) << 16);
+        words[i / 32] = ~gaps;
+    }
+    scanTail(text, length, words, full);
+}
+
+__attribute__((target("avx2")))
+void scanAVX2(const char *text, size_t length, uint32_t *words)
+{
+    const __m256i gap = _mm256_set1_epi8('-');
+    // Two words per iteration keep both load ports busy.
+    size_t full = length / 64 * 64;
+    for (size_t i = 0; i < full; i += 64)
+    {
+        __m256i low = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(text + i));
+        __m256i high = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(text + i + 32));
+        uint32_t low_gaps =
+            uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, gap)));
+        uint32_t high_gaps =
+            uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, gap)));
+        words[i / 32] = ~low_gaps;
+        words[i / 32 + 1] = ~high_gaps;
+    }
+    if (length - full >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(text + full));
+        words[full / 32] =
+            ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, gap)));
+        full += 32;
+    }
+    scanTail(text, length, words, full);
+}
+
+#endif /* GAPSCAN_X86 */
+
+GapScanKernel selectKernel()
+{
+#ifdef GAPSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return scanAVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return scanSSE2;
+    }
+#endif
+    return scanScalar;
+}
+
+} /* namespace */
+
+void FillNonGapBits(const char *text, size_t length,
+        cds_utils::BitString &bitstr)
+{
+    static const GapScanKernel kernel = selectKernel();
+    kernel(text, length, bitstr.getData());
+}
@@ -0,0 +1,430 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <zlib.h>
+
+#include <GzipReader.h>
+
+
+namespace
+{
+
+// Amount of compressed input handed to zlib at once; avail_in is only 32
+// bits wide.
+const size_t kMaxInflateInput = 1 << 30;
+// Output space added at a time while inflating plain gzip data.
+const size_t kInflateStep = 1 << 20;
+
+inline unsigned int readLittleEndian16(const char *data)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    return bytes[0] | (bytes[1] << 8);
+}
+
+inline uint32_t readLittleEndian32(const char *data)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16)
+        | (uint32_t(bytes[3]) << 24);
+}
+
+/*
+** Prepares stream for inflating raw deflate data, which is what BGZF
+** blocks hold. Returns false on failure.
+*/
+bool initRawInflate(z_stream &stream)
+{
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    return inflateInit2(&stream, -MAX_WBITS) == Z_OK;
+}
+
+} /* namespace */
+
+
+/*
+** Threads inflating BGZF blocks, kept for the whole life of a reader so
+** that reads don't pay for starting them. Each read hands its blocks to
+** all of the workers and the calling thread, which take the blocks one
+** by one, and waits until they are all done.
+*/
+class GzipReader::InflatePool
+{
+    public:
+        /*
+        ** Starts threads - 1 workers; the calling thread is the last one.
+        */
+        explicit InflatePool(size_t threads);
+        ~InflatePool();
+
+        /*
+        ** Inflates each of blocks to output + its offset. Returns false if
+        ** any of them is corrupt.
+        */
+        bool run(const std::vector<BgzfBlock> &blocks,
+                const std::vector<size_t> &offsets, Bytef *output);
+
+    private:
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable started_, finished_;
+        // Incremented for every read handed to the workers.
+        uint64_t generation_;
+        // Number of workers still busy with the current read.
+        size_t running_;
+        bool stopping_;
+        // The current read.
+        const std::vector<BgzfBlock> *blocks_;
+        const std::vector<size_t> *offsets_;
+        Bytef *output_;
+        std::atomic<size_t> next_block_;
+        std::atomic<bool> failed_;
+        // Used by the calling thread.
+        z_stream stream_;
+        bool stream_ready_;
+
+        void work();
+        // Inflates blocks of the current read until there are none left.
+        void inflateBlocks(z_stream &stream);
+        void stop();
+
+        // The following are forbidden.
+        InflatePool(const InflatePool &);
+        InflatePool & operator=(const InflatePool &);
+};
+
+GzipReader::InflatePool::InflatePool(size_t threads):
+    generation_(0), running_(0), stopping_(false), blocks_(NULL),
+    offsets_(NULL), output_(NULL), next_block_(0), failed_(false)
+{
+    this->stream_ready_ = initRawInflate(this->stream_);
+    try
+    {
+        for (size_t i = 1; i < threads; ++i)
+        {
+            this->workers_.push_back(std::thread(
+                        &GzipReader::InflatePool::work, this));
+        }
+    }
+    catch (...)
+    {
+        this->stop();
+        throw;
+    }
+}
+
+GzipReader::InflatePool::~InflatePool()
+{
+    this->stop();
+}
+
+void GzipReader::InflatePool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->stopping_ = true;
+    }
+    this->started_.notify_all();
+    for (auto it = this->workers_.begin(); it != this->workers_.end(); ++it)
+    {
+        it->join();
+    }
+    this->workers_.clear();
+    if (this->stream_ready_)
+    {
+        inflateEnd(&this->stream_);
+        this->stream_ready_ = false;
+    }
+}
+
+bool GzipReader::InflatePool::run(const std::vector<BgzfBlock> &blocks,
+        const std::vector<size_t> &offsets, Bytef *output)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->blocks_ = &blocks;
+        this->offsets_ = &offsets;
+        this->output_ = output;
+        this->next_block_ = 0;
+        this->failed_ = !this->stream_ready_;
+        this->running_ = this->workers_.size();
+        ++this->generation_;
+    }
+    this->started_.notify_all();
+    if (this->stream_ready_)
+    {
+        this->inflateBlocks(this->stream_);
+    }
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    while (this->running_ > 0)
+    {
+        this->finished_.wait(lock);
+    }
+    return !this->failed_;
+}
+
+void GzipReader::InflatePool::work()
+{
+    z_stream stream;
+    bool ready = initRawInflate(stream);
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    while (true)
+    {
+        while (!this->stopping_ && this->generation_ == generation)
+        {
+            this->started_.wait(lock);
+        }
+        if (this->stopping_)
+        {
+            break;
+        }
+        generation = this->generation_;
+        lock.unlock();
+        if (ready)
+        {
+            this->inflateBlocks(stream);
+        }
+        else
+        {
+            this->failed_ = true;
+        }
+        lock.lock();
+        if (--this->running_ == 0)
+        {
+            this->finished_.notify_all();
+        }
+    }
+    if (ready)
+    {
+        inflateEnd(&stream);
+    }
+}
+
+void GzipReader::InflatePool::inflateBlocks(z_stream &stream)
+{
+    const std::vector<BgzfBlock> &blocks = *this->blocks_;
+    size_t i;
+    while (!this->failed_ && (i = this->next_block_++) < blocks.size())
+    {
+        const BgzfBlock &block = blocks[i];
+        Bytef *output = this->output_ + (*this->offsets_)[i];
+        inflateReset(&stream);
+        stream.next_in = reinterpret_cast<Bytef *>(
+                const_cast<char *>(block.data));
+        stream.avail_in = block.compressed_size;
+        stream.next_out = output;
+        stream.avail_out = block.size;
+        if (inflate(&stream, Z_FINISH) != Z_STREAM_END
+                || stream.avail_out != 0
+                || crc32(0, output, block.size) != block.crc)
+        {
+            this->failed_ = true;
+        }
+    }
+}
+
+
+GzipReader::GzipReader(const char *begin, const char *end, size_t threads):
+    pos_(begin), end_(end), threads_(std::max<size_t>(threads, 1)),
+    bgzf_(isBgzf(begin, end)), pool_(NULL), finished_(false)
+{
+    if (!isGzip(begin, end))
+    {
+        throw DecompressionError();
+    }
+    if (this->bgzf_)
+    {
+        this->pool_ = new InflatePool(this->threads_);
+    }
+    else
+    {
+        this->stream_.zalloc = Z_NULL;
+        this->stream_.zfree = Z_NULL;
+        this->stream_.opaque = Z_NULL;
+        this->stream_.next_in = Z_NULL;
+        this->stream_.avail_in = 0;
+        // Accept the gzip wrapper only.
+        if (inflateInit2(&this->stream_, 16 + MAX_WBITS) != Z_OK)
+        {
+            throw DecompressionError();
+        }
+    }
+}
+
+GzipReader::~GzipReader()
+{
+    delete this->pool_;
+    if (!this->bgzf_)
+    {
+        inflateEnd(&this->stream_);
+    }
+}
+
+bool GzipReader::isGzip(const char *begin, const char *end)
+{
+    return (end - begin) >= 2 && static_cast<unsigned char>(begin[0]) == 0x1f
+        && static_cast<unsigned char>(begin[1]) == 0x8b;
+}
+
+bool GzipReader::isBgzf(const char *begin, const char *end)
+{
+    // A gzip header with the FEXTRA flag set, carrying a "BC" subfield.
+    if ((end - begin) < 18 || !isGzip(begin, end) || begin[2] != 8
+            || (begin[3] & 4) == 0)
+    {
+        return false;
+    }
+    const char *extra = begin + 12;
+    const char *extra_end = extra + readLittleEndian16(begin + 10);
+    if (extra_end > end)
+    {
+        return false;
+    }
+    while (extra + 4 <= extra_end)
+    {
+        unsigned int length = readLittleEndian16(extra + 2);
+        if (extra[0] == 'B' && extra[1] == 'C' && length == 2)
+        {
+            return true;
+        }
+        extra += 4 + length;
+    }
+    return false;
+}
+
+bool GzipReader::read(std::string &out, size_t amount)
+{
+    if (this->bgzf_)
+    {
+        return this->readBgzf(out, amount);
+    }
+    return this->readGzip(out, amount);
+}
+
+bool GzipReader::readGzip(std::string &out, size_t amount)
+{
+    z_stream &stream = this->stream_;
+    size_t appended = 0;
+    while (appended < amount && !this->finished_)
+    {
+        if (stream.avail_in == 0 && this->pos_ != this->end_)
+        {
+            stream.next_in = reinterpret_cast<Bytef *>(
+                    const_cast<char *>(this->pos_));
+            stream.avail_in = std::min<size_t>(this->end_ - this->pos_,
+                    kMaxInflateInput);
+            this->pos_ += stream.avail_in;
+        }
+
+        size_t old_size = out.size();
+        size_t step = std::max(amount - appended, kInflateStep);
+        out.resize(old_size + step);
+        stream.next_out = reinterpret_cast<Bytef *>(&out[old_size]);
+        stream.avail_out = step;
+        int result = inflate(&stream, Z_NO_FLUSH);
+        size_t produced = step - stream.avail_out;
+        out.resize(old_size + produced);
+        appended += produced;
+
+        if (result == Z_STREAM_END)
+        {
+            // Another member may follow; anything else after the end is
+            // treated as padding.
+            const char *rest = reinterpret_cast<const char *>(
+                    stream.next_in);
+            if (stream.avail_in == 0)
+            {
+                rest = this->pos_;
+            }
+            if (isGzip(rest, stream.avail_in ? rest + stream.avail_in
+                        : this->end_))
+            {
+                inflateReset(&stream);
+            }
+            else
+            {
+                this->finished_ = true;
+            }
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            throw DecompressionError();
+        }
+        else if (produced == 0 && stream.avail_in == 0
+                && this->pos_ == this->end_)
+        {
+            // The data ends in the middle of a member.
+            throw DecompressionError();
+        }
+    }
+    return !this->finished_;
+}
+
+GzipReader::BgzfBlock GzipReader::nextBgzfBlock()
+{
+    if (!isBgzf(this->pos_, this->end_))
+    {
+        throw DecompressionError();
+    }
+    unsigned int extra_length = readLittleEndian16(this->pos_ + 10);
+    const char *extra = this->pos_ + 12;
+    size_t block_size = 0;
+    while (block_size == 0)
+    {
+        unsigned int length = readLittleEndian16(extra + 2);
+        if (extra[0] == 'B' && extra[1] == 'C' && length == 2)
+        {
+            block_size = readLittleEndian16(extra + 4) + 1;
+        }
+        extra += 4 + length;
+    }
+    if (block_size < 12 + extra_length + 8
+            || block_size > size_t(this->end_ - this->pos_))
+    {
+        throw DecompressionError();
+    }
+
+    BgzfBlock block;
+    block.data = this->pos_ + 12 + extra_length;
+    block.compressed_size = block_size - 12 - extra_length - 8;
+    block.crc = readLittleEndian32(this->pos_ + block_size - 8);
+    block.size = readLittleEndian32(this->pos_ + block_size - 4);
+    this->pos_ += block_size;
+    return block;
+}
+
+bool GzipReader::readBgzf(std::string &out, size_t amount)
+{
+    // The trailers tell us how much each block inflates to, so the output
+    // can be laid out before any of them is decompressed.
+    std::vector<BgzfBlock> blocks;
+    std::vector<size_t> offsets;
+    size_t total = 0;
+    while (total < amount && this->pos_ != this->end_)
+    {
+        blocks.push_back(this->nextBgzfBlock());
+        offsets.push_back(total);
+        total += blocks.back().size;
+    }
+    size_t base = out.size();
+    out.resize(base + total);
+    if (total == 0)
+    {
+        return this->pos_ != this->end_;
+    }
+    Bytef *output = reinterpret_cast<Bytef *>(&out[base]);
+    if (!this->pool_->run(blocks, offsets, output))
+    {
+        throw DecompressionError();
+    }
+    return this->pos_ != this->end_;
+}
@@ -0,0 +1,140 @@
+#include <string>
+#include <stdexcept>
+
+#include <LazyAlignmentBlockStorage.h>
+#include <WholeGenomeAlignment.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <MafReader.h>
+#include <MafIndex.h>
+
+
+LazyAlignmentBlockStorage::LazyAlignmentBlockStorage(
+        const std::string &maf_file, maf_reader::MafIndex *index,
+        BitSequenceFactory &factory)
+try:
+    file_(maf_file, MappedFile::ACCESS_RANDOM), index_(index),
+    factory_(factory), wga_(NULL)
+{
+    if (index->source_size != this->file_.size())
+    {
+        throw SnapshotError();
+    }
+}
+catch (...)
+{
+    // The exception is rethrown automatically.
+    delete index;
+}
+
+LazyAlignmentBlockStorage::~LazyAlignmentBlockStorage()
+{
+    for (auto it = this->blocks_.begin(); it != this->blocks_.end(); ++it)
+    {
+        delete it->second;
+    }
+    delete this->index_;
+}
+
+void LazyAlignmentBlockStorage::addBlock(AlignmentBlock *)
+{
+    throw std::logic_error("blocks of a LazyAlignmentBlockStorage come "
+            "from its MAF file");
+}
+
+void LazyAlignmentBlockStorage::attach(WholeGenomeAlignment &wga)
+{
+    const maf_reader::MafIndex &index = *this->index_;
+    // The positions in the index are on its own reference.
+    if (wga.get_reference() != index.reference)
+    {
+        throw SnapshotError();
+    }
+    this->wga_ = &wga;
+    for (auto it = index.sequences.begin(); it != index.sequences.end();
+            ++it)
+    {
+        wga.requestSequenceId(it->first, it->second);
+    }
+}
+
+LazyAlignmentBlockStorage::iterator
+LazyAlignmentBlockStorage::find(const size_t pos)
+{
+    return iterator(this, this->findIndex(pos));
+}
+
+AlignmentBlock * LazyAlignmentBlockStorage::getBlock(const size_t pos)
+{
+    size_t i = this->findIndex(pos);
+    // Positions past the end of the block can be ruled out without
+    // parsing it.
+    if (pos > this->index_->blocks[i].reference_end)
+    {
+        throw OutOfSequence();
+    }
+    AlignmentBlock *block = this->materialize(i);
+    block->getReferenceSequence()->sequenceToAlignment(pos);
+    return block;
+}
+
+LazyAlignmentBlockStorage::iterator LazyAlignmentBlockStorage::begin()
+{
+    return iterator(this, 0);
+}
+
+LazyAlignmentBlockStorage::iterator LazyAlignmentBlockStorage::end()
+{
+    return iterator(this, this->size());
+}
+
+size_t LazyAlignmentBlockStorage::size() const
+{
+    return this->index_->blocks.size();
+}
+
+AlignmentBlock * LazyAlignmentBlockStorage::materialize(size_t i)
+{
+    auto it = this->blocks_.find(i);
+    if (it != this->blocks_.end())
+    {
+        return it->second;
+    }
+    // Without an alignment there is no way to assign sequence IDs.
+    if (this->wga_ == NULL)
+    {
+        throw std::logic_error("LazyAlignmentBlockStorage used without "
+                "a WholeGenomeAlignment");
+    }
+    const maf_reader::BlockLocation &location = this->index_->blocks[i];
+    const char *begin = this->file_.data() + location.offset;
+    AlignmentBlock *block = maf_reader::ReadMafBlock(begin,
+            begin + location.length, *this->wga_, this->factory_);
+    this->blocks_[i] = block;
+    return block;
+}
+
+size_t LazyAlignmentBlockStorage::findIndex(const size_t pos) const
+{
+    const std::vector<maf_reader::BlockLocation> &blocks =
+        this->index_->blocks;
+    if (blocks.empty() || blocks[0].reference_start > pos)
+    {
+        throw OutOfSequence();
+    }
+
+    size_t start = 0, end = blocks.size();
+    while ((end - start) > 1)
+    {
+        size_t middle = (start + end) / 2;
+        if (blocks[middle].reference_start <= pos)
+        {
+            start = middle;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+    return start;
+}
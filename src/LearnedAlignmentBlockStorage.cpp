@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+
+#include <LearnedAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+template <typename Segment>
+struct SegmentKeyLess
+{
+    bool operator()(size_t pos, const Segment &segment) const
+    {
+        return pos < segment.key;
+    }
+};
+
+} /* namespace */
+
+size_t LearnedAlignmentBlockStorage::findIndex(const size_t pos)
+{
+    const std::vector<size_t> &starts = this->starts_;
+    if (pos < starts.front())
+    {
+        throw OutOfSequence();
+    }
+    // The model ends at the last start, everything past it belongs to the
+    // last block.
+    if (pos >= starts.back())
+    {
+        return starts.size() - 1;
+    }
+
+    // The last piece starting at or before pos; its first key is the
+    // first start, so there always is one.
+    std::vector<Segment>::const_iterator segment = std::upper_bound(
+            this->segments_.begin(), this->segments_.end(), pos,
+            SegmentKeyLess<Segment>()) - 1;
+
+    // The number of blocks starting at or before pos is at most error_
+    // away from the prediction, so the first block past pos is found in
+    // the window around it.
+    double predicted = segment->intercept
+        + segment->slope * double(pos - segment->key);
+    double count = double(starts.size());
+    double low = std::floor(predicted) - double(this->error_);
+    double high = std::ceil(predicted) + double(this->error_);
+    size_t from = size_t(std::min(std::max(low, 0.0), count));
+    size_t to = size_t(std::min(std::max(high, 0.0), count));
+
+    size_t index = std::upper_bound(starts.begin() + from,
+            starts.begin() + to, pos) - starts.begin();
+    return index - 1;
+}
+
+LearnedIndexStats LearnedAlignmentBlockStorage::getStats()
+{
+    this->prepare();
+    LearnedIndexStats stats;
+    stats.segments = this->segments_.size();
+    stats.model_size = this->segments_.size() * sizeof(Segment);
+    stats.max_error = this->error_;
+    return stats;
+}
+
+void LearnedAlignmentBlockStorage::buildIndex()
+{
+    this->collectStarts(this->starts_);
+    this->fit();
+}
+
+void LearnedAlignmentBlockStorage::dropIndex()
+{
+    std::vector<size_t>().swap(this->starts_);
+    std::vector<Segment>().swap(this->segments_);
+    this->error_ = 0;
+}
+
+/*
+** Covers the number of blocks starting at or before each position, from
+** the first start to the last one, by as few lines as the shrinking cone
+** method finds: a piece grows as long as some slope keeps all its points
+** within max_error_ of the line through its first point.
+**
+** The count is a step function, constant from a start up to the position
+** before the next one. A line within the error at both ends of a step is
+** within it all along the step, so each run of blocks sharing a start
+** adds these two points, and pieces only break between runs. That way
+** no long run can pull the prediction away between two starts.
+*/
+void LearnedAlignmentBlockStorage::fit()
+{
+    const std::vector<size_t> &starts = this->starts_;
+    if (starts.empty())
+    {
+        return;
+    }
+
+    // The ranges are fitted on their own; each boundary is moved to the
+    // beginning of the run of equal starts it falls into.
+    std::vector<size_t> bounds = SplitRanges(starts.size(), this->threads_);
+    for (size_t i = 1; i + 1 < bounds.size(); ++i)
+    {
+        bounds[i] = std::max(bounds[i], bounds[i - 1]);
+        while (bounds[i] > bounds[i - 1]
+                && starts[bounds[i]] == starts[bounds[i] - 1])
+        {
+            --bounds[i];
+        }
+    }
+    size_t parts = bounds.size() - 1;
+    std::vector<std::vector<Segment> > pieces(parts);
+    std::vector<size_t> errors(parts, 0);
+    RunTasks(parts, [this, &bounds, &pieces, &errors](size_t part)
+    {
+        if (bounds[part] < bounds[part + 1])
+        {
+            errors[part] = this->fitRange(bounds[part], bounds[part + 1],
+                    pieces[part]);
+        }
+    });
+    for (size_t part = 0; part < parts; ++part)
+    {
+        this->segments_.insert(this->segments_.end(), pieces[part].begin(),
+                pieces[part].end());
+        this->error_ = std::max(this->error_, errors[part]);
+    }
+}
+
+size_t LearnedAlignmentBlockStorage::fitRange(size_t begin, size_t end,
+        std::vector<Segment> &segments) const
+{
+    const std::vector<size_t> &starts = this->starts_;
+    const double max_error = double(this->max_error_);
+
+    Segment current;
+    double min_slope = 0, max_slope = 0;
+    bool open = false;
+    size_t next = begin;
+    for (size_t i = begin; i < end; i = next)
+    {
+        for (next = i + 1; next < end && starts[next] == starts[i]; ++next)
+        { }
+        double count = double(next);
+        // The last run only adds its start.
+        size_t step_end = next < starts.size() ? starts[next] - 1
+            : starts[i];
+
+        if (open)
+        {
+            double low = min_slope, high = max_slope;
+            size_t ends[] = {starts[i], step_end};
+            for (size_t j = 0; j < 2; ++j)
+            {
+                double dx = double(ends[j] - current.key);
+                double dy = count - current.intercept;
+                low = std::max(low, (dy - max_error) / dx);
+                high = std::min(high, (dy + max_error) / dx);
+            }
+            if (low <= high)
+            {
+                min_slope = low;
+                max_slope = high;
+                current.last = next - 1;
+                continue;
+            }
+            current.slope = (min_slope + max_slope) / 2;
+            segments.push_back(current);
+        }
+        current.key = starts[i];
+        current.intercept = count;
+        current.last = next - 1;
+        min_slope = 0;
+        max_slope = HUGE_VAL;
+        if (step_end > starts[i])
+        {
+            max_slope = max_error / double(step_end - starts[i]);
+        }
+        open = true;
+    }
+    current.slope = max_slope == HUGE_VAL ? 0 : (min_slope + max_slope) / 2;
+    segments.push_back(current);
+
+    // Measure the error actually reached, floating point rounding
+    // included, since lookups rely on it.
+    size_t error = 0;
+    size_t first = begin;
+    for (auto it = segments.begin(); it != segments.end(); ++it)
+    {
+        for (size_t i = first; i <= it->last; i = next)
+        {
+            for (next = i + 1; next < end && starts[next] == starts[i];
+                    ++next)
+            { }
+            size_t step_end = next < starts.size() ? starts[next] - 1
+                : starts[i];
+            size_t ends[] = {starts[i], step_end};
+            for (size_t j = 0; j < 2; ++j)
+            {
+                double predicted = it->intercept
+                    + it->slope * double(ends[j] - it->key);
+                error = std::max(error, size_t(std::ceil(
+                                std::fabs(predicted - double(next)))));
+            }
+        }
+        first = it->last + 1;
+    }
+    return error;
+}
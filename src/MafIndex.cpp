@@ -0,0 +1,130 @@
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <BitSequence.h>
+
+#include <MafIndex.h>
+#include <SequenceDetails.h>
+
+
+using std::string;
+using cds_utils::saveValue;
+using cds_utils::loadValue;
+
+namespace maf_reader
+{
+
+namespace
+{
+
+const unsigned int kIndexMagic = 0x4946414d;
+const unsigned int kIndexVersion = 1;
+
+void saveString(std::ofstream &fp, const string &str)
+{
+    saveValue(fp, str.size());
+    fp.write(str.data(), str.size());
+}
+
+string loadString(std::ifstream &fp)
+{
+    size_t length = loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    // Make sure a corrupt length can't make us allocate more than the
+    // file holds.
+    std::streampos pos = fp.tellg();
+    fp.seekg(0, std::ios::end);
+    std::streampos end = fp.tellg();
+    fp.seekg(pos);
+    if (!fp.good() || size_t(end - pos) < length)
+    {
+        throw SnapshotError();
+    }
+    string str(length, ' ');
+    fp.read(&str[0], length);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    return str;
+}
+
+} /* namespace */
+
+void MafIndex::save(std::ofstream &fp) const
+{
+    saveValue(fp, kIndexMagic);
+    saveValue(fp, kIndexVersion);
+    saveString(fp, this->reference);
+    saveValue(fp, this->source_size);
+    saveValue(fp, this->sequences.size());
+    for (auto it = this->sequences.begin(); it != this->sequences.end();
+            ++it)
+    {
+        saveString(fp, it->first);
+        saveValue(fp, it->second);
+    }
+    saveValue(fp, this->blocks.size());
+    if (!this->blocks.empty())
+    {
+        saveValue(fp, &this->blocks[0], this->blocks.size());
+    }
+}
+
+MafIndex * MafIndex::load(std::ifstream &fp)
+{
+    if (loadValue<unsigned int>(fp) != kIndexMagic
+            || loadValue<unsigned int>(fp) != kIndexVersion)
+    {
+        throw SnapshotError();
+    }
+    MafIndex *index = new MafIndex();
+    try
+    {
+        index->reference = loadString(fp);
+        index->source_size = loadValue<uint64_t>(fp);
+        size_t count = loadValue<size_t>(fp);
+        for (size_t i = 0; i < count && fp.good(); ++i)
+        {
+            string name = loadString(fp);
+            size_t size = loadValue<size_t>(fp);
+            index->sequences.push_back(make_pair(name, size));
+        }
+        count = loadValue<size_t>(fp);
+        if (!fp.good())
+        {
+            throw SnapshotError();
+        }
+        // Make sure a corrupt count can't make us allocate more than the
+        // file holds.
+        std::streampos blocks_pos = fp.tellg();
+        fp.seekg(0, std::ios::end);
+        if (size_t(fp.tellg() - blocks_pos) < count * sizeof(BlockLocation))
+        {
+            throw SnapshotError();
+        }
+        fp.seekg(blocks_pos);
+        index->blocks.resize(count);
+        if (count > 0)
+        {
+            fp.read(reinterpret_cast<char *>(&index->blocks[0]),
+                    count * sizeof(BlockLocation));
+        }
+        if (!fp.good())
+        {
+            throw SnapshotError();
+        }
+    }
+    catch (...)
+    {
+        delete index;
+        throw;
+    }
+    return index;
+}
+
+} /* namespace maf_reader */
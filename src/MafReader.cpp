@@ -1,14 +1,36 @@
 #include <string>
 #include <set>
 #include <vector>
-#include <fstream>
 #include <istream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <map>
+#include <queue>
+#include <deque>
+#include <functional>
+#include <fstream>
 #include <sstream>
-#include <ios>
+#include <cstdio>
+#include <exception>
+#include <stdint.h>
+#include <dirent.h>
 
 #include <BitString.h>
 
 #include <MafReader.h>
+#include <MafIndex.h>
+#include <MappedFile.h>
+#include <MappedAlignment.h>
+#include <BoundedQueue.h>
+#include <GzipReader.h>
+#include <GapScan.h>
 #include <WholeGenomeAlignment.h>
 #include <AlignmentBlock.h>
 #include <SequenceDetails.h>
@@ -20,80 +42,494 @@ namespace maf_reader
 {
 
 using std::istream;
-using std::istringstream;
 using std::string;
 using std::set;
 using std::vector;
 
-string getNextLine(istream &s)
+/*
+** A non-owning view of a piece of the input. Lines and fields are passed
+** around as these so that parsing a memory mapped file does not need to
+** copy anything out of the mapping.
+*/
+struct TextRange
 {
-    using std::getline;
-    string buf;
-    getline(s, buf);
-    while ((!buf.empty())
-           && (buf[0] != 'a')
-           && (buf[0] != 's'))
+    const char *begin, *end;
+
+    TextRange():
+        begin(NULL), end(NULL)
+    { }
+    TextRange(const char *b, const char *e):
+        begin(b), end(e)
+    { }
+    bool empty() const
     {
-        getline(s, buf);
+        return this->begin == this->end;
     }
-    return buf;
+    size_t size() const
+    {
+        return this->end - this->begin;
+    }
+};
+
+/*
+** Returns the whole of str as a range; it is only valid as long as str
+** is not modified.
+*/
+TextRange rangeOf(const string &str)
+{
+    return TextRange(str.data(), str.data() + str.size());
 }
 
-bool passesLimitCheck(const string &line, const set<string> *limit)
+/*
+** Compares two names byte by byte, the way std::string does.
+*/
+int compareNames(const TextRange &a, const TextRange &b)
 {
-    if (limit == NULL)
+    int result = memcmp(a.begin, b.begin, std::min(a.size(), b.size()));
+    if (result != 0)
     {
-        return true;
+        return result;
     }
-    string buf;
-    istringstream s(line);
-    s >> buf;
-    s >> buf;
-    return limit->count(buf) != 0;
+    return (a.size() < b.size()) ? -1 : (a.size() > b.size()) ? 1 : 0;
 }
 
-SequenceDetails parseMafLine(const string &line, WholeGenomeAlignment &wga,
-        BitSequenceFactory &factory)
+struct NameLess
 {
-    istringstream s(line);
-    s.exceptions(istream::failbit | istream::badbit);
+    bool operator()(const TextRange &a, const TextRange &b) const
+    {
+        return compareNames(a, b) < 0;
+    }
+};
 
-    try
+/*
+** Returns the line starting at pos, without the line terminator, and
+** moves pos to the beginning of the following line.
+*/
+TextRange nextLine(const char *&pos, const char *end)
+{
+    const char *line_begin = pos;
+    const char *newline = static_cast<const char *>(
+            memchr(pos, '\n', end - pos));
+    if (newline == NULL)
+    {
+        pos = end;
+        newline = end;
+    }
+    else
+    {
+        pos = newline + 1;
+    }
+    // Tolerate DOS line endings.
+    if (newline != line_begin && newline[-1] == '\r')
+    {
+        --newline;
+    }
+    return TextRange(line_begin, newline);
+}
+
+/*
+** Stores the next whitespace-delimited field of line into field and
+** shrinks line accordingly. Returns false if there are no more fields.
+*/
+bool nextField(TextRange &line, TextRange &field)
+{
+    const char *pos = line.begin;
+    while (pos != line.end && (*pos == ' ' || *pos == '\t'))
+    {
+        ++pos;
+    }
+    const char *field_begin = pos;
+    while (pos != line.end && *pos != ' ' && *pos != '\t')
+    {
+        ++pos;
+    }
+    field = TextRange(field_begin, pos);
+    line.begin = pos;
+    return !field.empty();
+}
+
+/*
+** Like nextField, throws ParseError if the line is exhausted.
+*/
+TextRange requireField(TextRange &line)
+{
+    TextRange field(line.end, line.end);
+    if (!nextField(line, field))
+    {
+        throw ParseError();
+    }
+    return field;
+}
+
+/*
+** Parses a non-negative decimal number spanning the whole field. Throws
+** ParseError on anything else.
+*/
+size_t parseNumber(const TextRange &field)
+{
+    if (field.empty())
+    {
+        throw ParseError();
+    }
+    size_t result = 0;
+    for (const char *pos = field.begin; pos != field.end; ++pos)
     {
-        string buf, name;
+        if (*pos < '0' || *pos > '9')
+        {
+            throw ParseError();
+        }
+        result = result * 10 + (*pos - '0');
+    }
+    return result;
+}
+
+/*
+** A sorted copy of ReadOptions::limit which can be searched for a name
+** without copying it out of the input first.
+*/
+class NameLimit
+{
+    public:
+        explicit NameLimit(const set<string> *limit = NULL):
+            enabled_(limit != NULL)
+        {
+            if (limit != NULL)
+            {
+                this->names_.assign(limit->begin(), limit->end());
+            }
+        }
+
+        /*
+        ** Returns true if there is no limit or it contains name.
+        */
+        bool contains(const TextRange &name) const
+        {
+            if (!this->enabled_)
+            {
+                return true;
+            }
+            auto it = std::lower_bound(this->names_.begin(),
+                    this->names_.end(), name, Precedes());
+            return it != this->names_.end()
+                && compareNames(rangeOf(*it), name) == 0;
+        }
+
+    private:
+        bool enabled_;
+        // Sorted, as they come from the set.
+        vector<string> names_;
+
+        struct Precedes
+        {
+            bool operator()(const string &name, const TextRange &range) const
+            {
+                return compareNames(rangeOf(name), range) < 0;
+            }
+        };
+};
+
+/*
+** Remembers the IDs of the sequence names resolved through it, so that
+** a name seen before is resolved without copying it out of the input.
+** Only the first request of a name reaches the alignment, which is all
+** requestSequenceId needs to record the size.
+*/
+class SequenceIdCache
+{
+    public:
+        seqid_t resolve(const TextRange &name, size_t size,
+                WholeGenomeAlignment &wga)
+        {
+            auto it = this->ids_.find(name);
+            if (it != this->ids_.end())
+            {
+                return it->second;
+            }
+            this->names_.push_back(string(name.begin, name.end));
+            const string &copy = this->names_.back();
+            seqid_t id = wga.requestSequenceId(copy, size);
+            this->ids_.insert(std::make_pair(rangeOf(copy), id));
+            return id;
+        }
+
+    private:
+        // Owns the names the keys of ids_ point to; a deque never moves
+        // its elements when growing.
+        std::deque<string> names_;
+        std::map<TextRange, seqid_t, NameLess> ids_;
+};
+
+/*
+** A BitString which can be resized, reusing its buffer as long as it is
+** large enough. Only the words covering the new length are guaranteed to
+** be valid; the caller is expected to overwrite all of them.
+*/
+class ScratchBitString: public cds_utils::BitString
+{
+    public:
+        ScratchBitString():
+            BitString(0), capacity_(this->uintLength)
+        { }
 
-        // Skip the "s" marker at the beginning of the line.
-        s >> buf;
-        s >> name;
+        const uint32_t * words() const
+        {
+            return this->data;
+        }
+        size_t wordCount() const
+        {
+            return this->uintLength;
+        }
 
-        size_t start, size, src_size;
-        bool reverse = false;
-        s >> start >> size >> buf >> src_size;
-        if (buf[0] == '-')
+        void reset(size_t length)
         {
-            reverse = true;
+            size_t words = length / 32 + 1;
+            if (words > this->capacity_)
+            {
+                delete [] this->data;
+                this->data = new uint32_t[words];
+                this->capacity_ = words;
+            }
+            this->length = length;
+            this->uintLength = words;
+            // The last word may lie entirely past the end, make sure it
+            // doesn't contribute any stray ones.
+            this->data[words - 1] = 0;
         }
 
-        // We build a BitString according to the sequence we read, dashes (aka
-        // insertions) are zeroes, everything else is one.
-        s >> buf;
-        cds_utils::BitString bitstr(buf.size());
-        for (size_t i = 0; i < buf.size(); ++i)
+    private:
+        size_t capacity_;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+** Statistics gathered by a single thread, which are added to the shared
+** ones by StatsCollector from time to time.
+*/
+struct ThreadStats
+{
+    ThreadStats():
+        bytes(0), paragraphs(0), rows(0), tokenize(0), build(0), resolve(0)
+    { }
+
+    uint64_t bytes, paragraphs, rows;
+    Clock::duration tokenize, build, resolve;
+};
+
+/*
+** Adds the wall-clock time between its construction and destruction to
+** total, unless disabled.
+*/
+class PhaseTimer
+{
+    public:
+        PhaseTimer(bool enabled, Clock::duration &total):
+            total_(enabled ? &total : NULL)
+        {
+            if (this->total_ != NULL)
+            {
+                this->start_ = Clock::now();
+            }
+        }
+        ~PhaseTimer()
         {
-            bitstr.setBit(i, buf[i] != '-');
+            if (this->total_ != NULL)
+            {
+                *this->total_ += Clock::now() - this->start_;
+            }
         }
 
-        cds_static::BitSequence *bitseq = factory.getInstance(bitstr);
+    private:
+        Clock::duration *total_;
+        Clock::time_point start_;
+};
+
+/*
+** Buffers reused from one row to the next, so that parsing does not touch
+** the heap except for the BitSequences being built. Each thread needs its
+** own instance. The statistics of the thread are kept here as well; they
+** are only gathered if timed is set.
+*/
+struct ParseScratch
+{
+    explicit ParseScratch(bool timed=false):
+        timed(timed)
+    { }
+
+    ScratchBitString bitstr;
+    // IDs resolved by this thread; a scratch must only ever be used with
+    // a single alignment.
+    SequenceIdCache ids;
+    bool timed;
+    ThreadStats stats;
+};
+
+/*
+** A row of a block which has been parsed, but whose sequence name has not
+** been resolved to an ID yet. Keeping the two steps apart lets us parse
+** blocks in parallel while still assigning IDs in input order.
+**
+** Tokenizing a row leaves bitseq NULL; it is filled in by buildRowBits.
+*/
+struct ParsedRow
+{
+    TextRange name, text;
+    size_t start, src_size;
+    bool reverse;
+    cds_static::BitSequence *bitseq;
+};
+
+typedef vector<ParsedRow> ParsedBlock;
+
+/*
+** Tokenizes an "s" line in a single pass. Returns false if the sequence
+** is excluded by limit.
+**
+** Throws ParseError on malformed lines.
+*/
+bool tokenizeMafRow(const TextRange &line, const NameLimit &limit,
+        ParsedRow &row)
+{
+    TextRange rest = line;
+
+    // Skip the "s" marker at the beginning of the line.
+    requireField(rest);
+    row.name = requireField(rest);
+    if (!limit.contains(row.name))
+    {
+        return false;
+    }
+
+    row.start = parseNumber(requireField(rest));
+    // The size is implied by the sequence text itself.
+    parseNumber(requireField(rest));
+    TextRange strand = requireField(rest);
+    row.src_size = parseNumber(requireField(rest));
+    row.reverse = (*strand.begin == '-');
+    row.text = requireField(rest);
+    row.bitseq = NULL;
+    return true;
+}
+
+/*
+** Builds the BitSequence of a tokenized row.
+*/
+void buildRowBits(ParsedRow &row, BitSequenceFactory &factory,
+        ParseScratch &scratch)
+{
+    // We build a BitString according to the sequence we read, dashes (aka
+    // insertions) are zeroes, everything else is one.
+    scratch.bitstr.reset(row.text.size());
+    FillNonGapBits(row.text.begin, row.text.size(), scratch.bitstr);
+    row.bitseq = factory.getInstance(scratch.bitstr);
+}
+
+/*
+** Tokenizes an "s" line and builds the BitSequence of its row. Returns
+** false, without building anything, if the sequence is excluded by limit.
+**
+** Throws ParseError on malformed lines.
+*/
+bool parseMafRow(const TextRange &line, BitSequenceFactory &factory,
+        const NameLimit &limit, ParseScratch &scratch, ParsedRow &row)
+{
+    if (!tokenizeMafRow(line, limit, row))
+    {
+        return false;
+    }
+    buildRowBits(row, factory, scratch);
+    return true;
+}
 
-        seqid_t id = wga.requestSequenceId(name, src_size);
+/*
+** The fields of an "s" line preceding the sequence text.
+*/
+struct RowHeader
+{
+    TextRange name;
+    size_t start, size, src_size;
+    bool reverse;
 
-        // We have all we need, create and return the instance.
-        return SequenceDetails(start, reverse, src_size, id, bitseq);
+    /*
+    ** Returns the position of the first nucleotide on the forward strand,
+    ** the same as SequenceDetails::get_start.
+    */
+    size_t forwardStart() const
+    {
+        return this->reverse ? this->src_size - this->start - 1
+            : this->start;
     }
-    catch (std::ios_base::failure &e)
+    /*
+    ** Returns the lowest and the highest position on the forward strand
+    ** covered by the row, whichever strand it is on.
+    */
+    size_t forwardFirst() const
     {
-        throw ParseError();
+        if (this->reverse && this->size > 0)
+        {
+            return this->forwardStart() - this->size + 1;
+        }
+        return this->forwardStart();
+    }
+    size_t forwardLast() const
+    {
+        if (this->reverse || this->size == 0)
+        {
+            return this->forwardStart();
+        }
+        return this->start + this->size - 1;
+    }
+};
+
+/*
+** Tokenizes the fields of an "s" line up to the source size, leaving the
+** sequence text alone.
+**
+** Throws ParseError on malformed lines.
+*/
+void parseRowHeader(const TextRange &line, RowHeader &header)
+{
+    TextRange rest = line;
+    requireField(rest);
+    header.name = requireField(rest);
+    header.start = parseNumber(requireField(rest));
+    header.size = parseNumber(requireField(rest));
+    header.reverse = (*requireField(rest).begin == '-');
+    header.src_size = parseNumber(requireField(rest));
+}
+
+SequenceDetails resolveRow(const ParsedRow &row, WholeGenomeAlignment &wga,
+        ParseScratch &scratch)
+{
+    seqid_t id;
+    {
+        PhaseTimer timer(scratch.timed, scratch.stats.resolve);
+        id = scratch.ids.resolve(row.name, row.src_size, wga);
+    }
+    return SequenceDetails(row.start, row.reverse, row.src_size, id,
+            row.bitseq);
+}
+
+/*
+** Frees the BitSequences of rows which never made it into a block.
+*/
+void discardRows(ParsedBlock &rows)
+{
+    for (auto it = rows.begin(); it != rows.end(); ++it)
+    {
+        delete it->bitseq;
     }
+    rows.clear();
+}
+
+SequenceDetails parseMafLine(const string &line, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory)
+{
+    ParseScratch scratch;
+    ParsedRow row;
+    parseMafRow(TextRange(line.data(), line.data() + line.size()), factory,
+            NameLimit(), scratch, row);
+    return resolveRow(row, wga, scratch);
 }
 
 AlignmentBlock * ParseMafBlock(const vector<string> &block_lines,
@@ -117,69 +553,1969 @@ AlignmentBlock * ParseMafBlock(const vector<string> &block_lines,
     return block;
 }
 
-void ReadMafFile(const string &file_name, WholeGenomeAlignment &wga,
-        BitSequenceFactory &factory, const set<string> *limit)
+/*
+** Tokenizes the rows of a paragraph, i. e. an "a" line followed by the
+** lines up to the next empty line, and appends them to rows. Only "s"
+** lines are taken into account.
+**
+** Throws ParseError; rows tokenized up to that point are left in rows.
+*/
+void tokenizeParagraphRows(const TextRange &paragraph,
+        const NameLimit &limit, ParseScratch &scratch, ParsedBlock &rows)
+{
+    PhaseTimer timer(scratch.timed, scratch.stats.tokenize);
+    size_t first_row = rows.size();
+    const char *pos = paragraph.begin;
+    // Skip the line marking the start of a block.
+    nextLine(pos, paragraph.end);
+    ParsedRow row;
+    while (pos != paragraph.end)
+    {
+        TextRange line = nextLine(pos, paragraph.end);
+        if (line.empty())
+        {
+            continue;
+        }
+        if (*line.begin == 'a')
+        {
+            throw ParseError();
+        }
+        if (*line.begin == 's' && tokenizeMafRow(line, limit, row))
+        {
+            rows.push_back(row);
+        }
+    }
+    ++scratch.stats.paragraphs;
+    scratch.stats.rows += rows.size() - first_row;
+}
+
+/*
+** Builds the BitSequences of all tokenized rows of a block.
+*/
+void buildBlockRows(ParsedBlock &rows, BitSequenceFactory &factory,
+        ParseScratch &scratch)
 {
-    std::ifstream s(file_name.c_str());
-    ReadMafFile(s, wga, factory, limit);
+    PhaseTimer timer(scratch.timed, scratch.stats.build);
+    for (auto it = rows.begin(); it != rows.end(); ++it)
+    {
+        buildRowBits(*it, factory, scratch);
+    }
 }
 
-void ReadMafFile(istream &s, WholeGenomeAlignment &wga,
-        BitSequenceFactory &factory, const set<string> *limit)
+/*
+** Tokenizes the rows of a paragraph and builds their BitSequences.
+**
+** Throws ParseError; rows parsed up to that point are left in rows.
+*/
+void parseParagraphRows(const TextRange &paragraph,
+        BitSequenceFactory &factory, const NameLimit &limit,
+        ParseScratch &scratch, ParsedBlock &rows)
+{
+    tokenizeParagraphRows(paragraph, limit, scratch, rows);
+    buildBlockRows(rows, factory, scratch);
+}
+
+/*
+** Turns parsed rows into a block, assigning sequence IDs on the way. The
+** BitSequences are handed over to the block.
+*/
+AlignmentBlock * buildBlock(ParsedBlock &rows, WholeGenomeAlignment &wga,
+        ParseScratch &scratch)
+{
+    AlignmentBlock *block = new AlignmentBlock();
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        block->addSequence(resolveRow(rows[i], wga, scratch));
+        rows[i].bitseq = NULL;
+    }
+    rows.clear();
+    return block;
+}
+
+/*
+** Parses a paragraph into a new block. rows is a scratch buffer which
+** may be reused between calls.
+*/
+AlignmentBlock * ParseMafParagraph(const TextRange &paragraph,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory,
+        const NameLimit &limit, ParseScratch &scratch, ParsedBlock &rows)
 {
-    s.exceptions(istream::failbit | istream::badbit);
     try
     {
-        bool can_continue = true;
-        // For each block...
-        while (can_continue)
+        parseParagraphRows(paragraph, factory, limit, scratch, rows);
+    }
+    catch (ParseError &e)
+    {
+        discardRows(rows);
+        throw;
+    }
+    return buildBlock(rows, wga, scratch);
+}
+
+/*
+** Decides whether a paragraph is worth parsing according to the block
+** filters of ReadOptions: its score, where its reference row lies and how
+** long it is, and how many informant rows it has. Only the "a" line and
+** the headers of the "s" lines are looked at to find out, so rows of
+** dropped blocks are never tokenized, let alone turned into BitSequences.
+*/
+class BlockFilter
+{
+    public:
+        BlockFilter(const string &reference, const ReadOptions &options):
+            reference_(reference), limit_(options.limit),
+            has_intervals_(options.intervals != NULL),
+            min_score_(options.min_score),
+            min_reference_length_(options.min_reference_length),
+            min_informants_(options.min_informants)
         {
-            vector<string> block_lines;
-            string buf = getNextLine(s);
-            // Skip the first empty line preceding all blocks.
-            if (buf.empty())
+            this->needs_reference_ = this->has_intervals_
+                || this->min_reference_length_ > 0;
+            this->enabled_ = this->needs_reference_
+                || this->min_score_ > kNoMinScore
+                || this->min_informants_ > 0;
+            if (options.intervals == NULL)
             {
-                buf = getNextLine(s);
+                return;
             }
-            while (buf[0] != 'a')
+            // Sort and merge the intervals, so that a single binary search
+            // tells whether a block overlaps any of them.
+            vector<std::pair<size_t, size_t> > sorted(*options.intervals);
+            std::sort(sorted.begin(), sorted.end());
+            for (auto it = sorted.begin(); it != sorted.end(); ++it)
             {
-                // We encountered an invalid paragraph, skip it.
-                buf = getNextLine(s);
-                while (!buf.empty())
+                if (it->first > it->second)
+                {
+                    continue;
+                }
+                if (!this->intervals_.empty()
+                        && it->first <= this->intervals_.back().second)
+                {
+                    this->intervals_.back().second = std::max(
+                            this->intervals_.back().second, it->second);
+                }
+                else
                 {
-                    buf = getNextLine(s);
+                    this->intervals_.push_back(*it);
                 }
-                buf = getNextLine(s);
             }
-            // Skip the line marking the start of a block.
-            buf = getNextLine(s);
-            // This try block is required to finish the last alignment
-            // block in the MAF and successfully add it to our WGA.
-            try
+        }
+
+        /*
+        ** Returns the names of the sequences whose rows are kept.
+        */
+        const NameLimit & limit() const
+        {
+            return this->limit_;
+        }
+
+        /*
+        ** Throws ParseError if the score or the reference row can't be
+        ** parsed.
+        */
+        bool accepts(const TextRange &paragraph) const
+        {
+            if (!this->enabled_)
+            {
+                return true;
+            }
+            const char *pos = paragraph.begin;
+            TextRange line = nextLine(pos, paragraph.end);
+            double score;
+            if (this->min_score_ > kNoMinScore && parseScore(line, score)
+                    && score < this->min_score_)
+            {
+                return false;
+            }
+
+            RowHeader header;
+            bool has_reference = false;
+            size_t informants = 0;
+            while (pos != paragraph.end)
             {
-                // Iterate over the block itself.
-                while (!buf.empty())
+                line = nextLine(pos, paragraph.end);
+                if (line.empty() || *line.begin != 's')
+                {
+                    continue;
+                }
+                TextRange rest = line, name;
+                nextField(rest, name);
+                if (!nextField(rest, name))
+                {
+                    continue;
+                }
+                if (name.size() == this->reference_.size()
+                        && memcmp(name.begin, this->reference_.data(),
+                            name.size()) == 0)
                 {
-                    if (buf[0] != 's')
+                    parseRowHeader(line, header);
+                    has_reference = true;
+                    if (this->min_informants_ == 0)
                     {
-                        throw ParseError();
+                        break;
                     }
-                    if (passesLimitCheck(buf, limit))
+                }
+                else if (this->min_informants_ > 0)
+                {
+                    if (this->limit_.contains(name))
                     {
-                        block_lines.push_back(buf);
+                        ++informants;
                     }
-                    buf = getNextLine(s);
                 }
             }
-            catch (std::ios_base::failure &e)
+
+            if (!has_reference)
+            {
+                // Blocks without the reference can't be looked up anyway.
+                if (this->needs_reference_)
+                {
+                    return false;
+                }
+            }
+            else if (header.size < this->min_reference_length_
+                    || (this->has_intervals_
+                        && !this->overlaps(header.forwardFirst(),
+                            header.forwardLast())))
+            {
+                return false;
+            }
+            return informants >= this->min_informants_;
+        }
+
+    private:
+        const string &reference_;
+        NameLimit limit_;
+        bool has_intervals_, needs_reference_, enabled_;
+        double min_score_;
+        size_t min_reference_length_, min_informants_;
+        // Disjoint and sorted.
+        vector<std::pair<size_t, size_t> > intervals_;
+
+        /*
+        ** Finds the score=... field of an "a" line. Returns false if
+        ** there is none.
+        */
+        static bool parseScore(const TextRange &line, double &score)
+        {
+            static const char kKey[] = "score=";
+            const size_t key_length = sizeof(kKey) - 1;
+            TextRange rest = line, field;
+            // Skip the "a" marker.
+            nextField(rest, field);
+            while (nextField(rest, field))
+            {
+                if (field.size() <= key_length
+                        || memcmp(field.begin, kKey, key_length) != 0)
+                {
+                    continue;
+                }
+                // The field is not null-terminated.
+                char buffer[64];
+                size_t length = field.size() - key_length;
+                if (length >= sizeof(buffer))
+                {
+                    throw ParseError();
+                }
+                memcpy(buffer, field.begin + key_length, length);
+                buffer[length] = '\0';
+                char *end;
+                score = strtod(buffer, &end);
+                if (end != buffer + length)
+                {
+                    throw ParseError();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        bool overlaps(size_t first, size_t last) const
+        {
+            // The first interval not ending before the row starts.
+            size_t start = 0, end = this->intervals_.size();
+            while (start < end)
+            {
+                size_t middle = (start + end) / 2;
+                if (this->intervals_[middle].second < first)
+                {
+                    start = middle + 1;
+                }
+                else
+                {
+                    end = middle;
+                }
+            }
+            return start < this->intervals_.size()
+                && this->intervals_[start].first <= last;
+        }
+};
+
+/*
+** Finds the next paragraph starting with an "a" line at or after pos and
+** stores it into paragraph. Everything outside such paragraphs (headers,
+** comments, stray lines) is skipped. Returns false when the input is
+** exhausted.
+*/
+bool nextParagraph(const char *&pos, const char *end, TextRange &paragraph)
+{
+    while (pos != end)
+    {
+        const char *paragraph_begin = pos;
+        TextRange line = nextLine(pos, end);
+        if (line.empty() || *line.begin != 'a')
+        {
+            continue;
+        }
+        while (pos != end)
+        {
+            const char *line_begin = pos;
+            if (nextLine(pos, end).empty())
+            {
+                pos = line_begin;
+                break;
+            }
+        }
+        paragraph = TextRange(paragraph_begin, pos);
+        return true;
+    }
+    return false;
+}
+
+/*
+** Gathers the statistics of all threads taking part in reading a MAF and
+** passes them on to ReadOptions::stats. Does nothing if that is NULL.
+*/
+class StatsCollector
+{
+    public:
+        explicit StatsCollector(const ReadOptions &options):
+            sink_(options.stats), threads_(options.threads),
+            start_(Clock::now()), last_report_(start_),
+            interval_(std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(
+                            options.progress_interval)))
+        { }
+
+        bool enabled() const
+        {
+            return this->sink_ != NULL;
+        }
+
+        /*
+        ** Adds the statistics of a thread and resets them. Thread-safe.
+        */
+        void add(ThreadStats &stats)
+        {
+            if (!this->enabled())
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->totals_.bytes += stats.bytes;
+            this->totals_.paragraphs += stats.paragraphs;
+            this->totals_.rows += stats.rows;
+            this->totals_.tokenize += stats.tokenize;
+            this->totals_.build += stats.build;
+            this->totals_.resolve += stats.resolve;
+            stats = ThreadStats();
+        }
+
+        /*
+        ** Calls ReadStatsSink::progress if the progress interval has
+        ** elapsed. Has to be called from the thread which called
+        ** ReadMafFile.
+        */
+        void report()
+        {
+            if (!this->enabled())
+            {
+                return;
+            }
+            Clock::time_point now = Clock::now();
+            if (now - this->last_report_ >= this->interval_)
+            {
+                this->last_report_ = now;
+                this->sink_->progress(this->snapshot(0));
+            }
+        }
+
+        /*
+        ** Prepares storage using all the threads of the read and calls
+        ** ReadStatsSink::finished.
+        */
+        void finish(AlignmentBlockStorage *storage)
+        {
+            if (!this->enabled())
+            {
+                return;
+            }
+            Clock::duration prepare(0);
+            if (storage != NULL)
             {
-                can_continue = false;
+                PhaseTimer timer(true, prepare);
+                storage->prepare(this->threads_);
             }
-            wga.addBlock(ParseMafBlock(block_lines, wga, factory));
+            this->sink_->finished(this->snapshot(seconds(prepare)));
         }
+
+    private:
+        ReadStatsSink *sink_;
+        size_t threads_;
+        Clock::time_point start_, last_report_;
+        Clock::duration interval_;
+        std::mutex mutex_;
+        ThreadStats totals_;
+
+        static double seconds(Clock::duration duration)
+        {
+            return std::chrono::duration<double>(duration).count();
+        }
+
+        ReadStats snapshot(double prepare_time)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            ReadStats stats;
+            stats.bytes_read = this->totals_.bytes;
+            stats.paragraphs = this->totals_.paragraphs;
+            stats.rows = this->totals_.rows;
+            stats.tokenize_time = seconds(this->totals_.tokenize);
+            stats.build_time = seconds(this->totals_.build);
+            stats.resolve_time = seconds(this->totals_.resolve);
+            stats.prepare_time = prepare_time;
+            stats.total_time = seconds(Clock::now() - this->start_);
+            return stats;
+        }
+};
+
+/*
+** Parses a whole MAF held in memory, one block after another.
+*/
+void ReadMafBuffer(const char *begin, const char *end,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory,
+        const ReadOptions &options, StatsCollector &stats)
+{
+    BlockFilter filter(wga.get_reference(), options);
+    ParseScratch scratch(stats.enabled());
+    ParsedBlock rows;
+    TextRange paragraph;
+    while (nextParagraph(begin, end, paragraph))
+    {
+        scratch.stats.bytes += paragraph.size();
+        if (filter.accepts(paragraph))
+        {
+            wga.addBlock(ParseMafParagraph(paragraph, wga, factory,
+                        filter.limit(), scratch, rows));
+        }
+        stats.add(scratch.stats);
+        stats.report();
+    }
+}
+
+/*
+** Returns the beginning of the first "a" line at or after pos, or end if
+** there is none. Since "a" lines only ever open a paragraph, this is a
+** safe place to split the input.
+*/
+const char * findParagraphStart(const char *pos, const char *begin,
+        const char *end)
+{
+    if (pos != begin && pos[-1] != '\n')
+    {
+        nextLine(pos, end);
+    }
+    while (pos != end && *pos != 'a')
+    {
+        nextLine(pos, end);
+    }
+    return pos;
+}
+
+// Parallel parsing hands out chunks of roughly this size to the threads,
+// unless that would leave some of them idle.
+const size_t kParallelChunkSize = 4 << 20;
+// Paragraphs read ahead from a stream before they are parsed in parallel.
+const size_t kStreamBatchSize = 64 << 20;
+
+/*
+** The blocks parsed from one chunk of the input, waiting to be merged
+** into the alignment.
+*/
+struct ParsedChunk
+{
+    ParsedChunk():
+        done(false)
+    { }
+
+    const char *begin, *end;
+    vector<ParsedBlock> blocks;
+    std::exception_ptr error;
+    bool done;
+};
+
+void discardChunk(ParsedChunk &chunk)
+{
+    for (auto it = chunk.blocks.begin(); it != chunk.blocks.end(); ++it)
+    {
+        discardRows(*it);
+    }
+    chunk.blocks.clear();
+}
+
+/*
+** Parses a MAF held in memory using the given number of threads. The
+** input is cut into chunks at paragraph boundaries which the worker
+** threads parse independently, including the construction of
+** BitSequences. The calling thread then merges the chunks into wga in
+** input order, so sequence IDs end up the same as with a sequential read.
+*/
+void ReadMafBufferParallel(const char *begin, const char *end,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory,
+        const ReadOptions &options, StatsCollector &stats)
+{
+    size_t threads = options.threads;
+    BlockFilter filter(wga.get_reference(), options);
+    size_t chunk_count = std::min(threads * 8,
+            (end - begin) / kParallelChunkSize + threads);
+    vector<ParsedChunk> chunks;
+    chunks.reserve(chunk_count);
+    const char *chunk_begin = begin;
+    for (size_t i = 1; i <= chunk_count && chunk_begin != end; ++i)
+    {
+        const char *chunk_end = end;
+        if (i < chunk_count)
+        {
+            chunk_end = findParagraphStart(std::max(chunk_begin,
+                        begin + (end - begin) / chunk_count * i), begin, end);
+        }
+        if (chunk_end == chunk_begin)
+        {
+            continue;
+        }
+        chunks.push_back(ParsedChunk());
+        chunks.back().begin = chunk_begin;
+        chunks.back().end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    std::mutex mutex;
+    std::condition_variable chunk_done;
+    std::atomic<size_t> next_chunk(0);
+    std::atomic<bool> aborted(false);
+
+    auto worker = [&]()
+    {
+        ParseScratch scratch(stats.enabled());
+        size_t i;
+        while (!aborted && (i = next_chunk++) < chunks.size())
+        {
+            ParsedChunk &chunk = chunks[i];
+            try
+            {
+                const char *pos = chunk.begin;
+                TextRange paragraph;
+                while (nextParagraph(pos, chunk.end, paragraph))
+                {
+                    scratch.stats.bytes += paragraph.size();
+                    // The block is added first, so that the paragraph
+                    // which fails is always the last one.
+                    chunk.blocks.push_back(ParsedBlock());
+                    if (!filter.accepts(paragraph))
+                    {
+                        chunk.blocks.pop_back();
+                        continue;
+                    }
+                    parseParagraphRows(paragraph, factory, filter.limit(),
+                            scratch, chunk.blocks.back());
+                }
+            }
+            catch (...)
+            {
+                chunk.error = std::current_exception();
+            }
+            stats.add(scratch.stats);
+            std::lock_guard<std::mutex> lock(mutex);
+            chunk.done = true;
+            chunk_done.notify_all();
+        }
+    };
+
+    vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(threads, chunks.size()); ++i)
+    {
+        workers.push_back(std::thread(worker));
+    }
+
+    ParseScratch scratch(stats.enabled());
+    size_t merged = 0;
+    try
+    {
+        for (; merged < chunks.size(); ++merged)
+        {
+            ParsedChunk &chunk = chunks[merged];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!chunk.done)
+                {
+                    chunk_done.wait(lock);
+                }
+            }
+            // Blocks preceding the error make it into wga, just like they
+            // would when reading sequentially.
+            for (auto it = chunk.blocks.begin(); it != chunk.blocks.end();
+                    ++it)
+            {
+                if (chunk.error && it + 1 == chunk.blocks.end())
+                {
+                    break;
+                }
+                wga.addBlock(buildBlock(*it, wga, scratch));
+            }
+            discardChunk(chunk);
+            if (chunk.error)
+            {
+                std::rethrow_exception(chunk.error);
+            }
+            stats.add(scratch.stats);
+            stats.report();
+        }
+    }
+    catch (...)
+    {
+        aborted = true;
+        for (auto it = workers.begin(); it != workers.end(); ++it)
+        {
+            it->join();
+        }
+        for (; merged < chunks.size(); ++merged)
+        {
+            discardChunk(chunks[merged]);
+        }
+        throw;
+    }
+
+    for (auto it = workers.begin(); it != workers.end(); ++it)
+    {
+        it->join();
+    }
+}
+
+/*
+** Appends the next paragraph from s to buffer, using line as a scratch
+** buffer. Both buffers are meant to be reused between calls, which keeps
+** the number of allocations independent of the number of lines. Returns
+** false when the input is exhausted.
+*/
+bool readParagraph(istream &s, string &buffer, string &line)
+{
+    using std::getline;
+    while (getline(s, line))
+    {
+        if (!line.empty() && line[0] == 'a')
+        {
+            break;
+        }
+    }
+    if (line.empty() || line[0] != 'a')
+    {
+        return false;
+    }
+    do
+    {
+        buffer.append(line);
+        buffer.push_back('\n');
+    }
+    while (getline(s, line) && !line.empty() && line != "\r");
+    return true;
+}
+
+/*
+** Returns the beginning of the last "a" line between begin and end, or
+** begin if there is none. Everything before it consists of complete
+** paragraphs even if the input continues past end.
+*/
+const char * findLastParagraphStart(const char *begin, const char *end)
+{
+    const char *pos = end;
+    while (pos != begin)
+    {
+        --pos;
+        if (*pos == 'a' && (pos == begin || pos[-1] == '\n'))
+        {
+            return pos;
+        }
+    }
+    return begin;
+}
+
+/*
+** Produces the paragraphs of a MAF which is not available in memory as a
+** whole.
+*/
+class ParagraphSource
+{
+    public:
+        virtual ~ParagraphSource()
+        { }
+
+        /*
+        ** Appends complete paragraphs to buffer until it holds at least
+        ** amount bytes or the input ends. Returns false once the input is
+        ** exhausted.
+        */
+        virtual bool fill(string &buffer, size_t amount) = 0;
+};
+
+class StreamParagraphSource: public ParagraphSource
+{
+    public:
+        explicit StreamParagraphSource(istream &s):
+            s_(s)
+        { }
+
+        virtual bool fill(string &buffer, size_t amount)
+        {
+            while (buffer.size() < amount)
+            {
+                if (!readParagraph(this->s_, buffer, this->line_))
+                {
+                    return false;
+                }
+                // Keep the paragraphs apart.
+                buffer.push_back('\n');
+            }
+            return true;
+        }
+
+    private:
+        istream &s_;
+        string line_;
+};
+
+/*
+** Decompresses gzip data on the fly. A paragraph cut in half by the end
+** of the decompressed data is held back until the rest of it arrives.
+*/
+class GzipParagraphSource: public ParagraphSource
+{
+    public:
+        GzipParagraphSource(const char *begin, const char *end,
+                size_t threads):
+            reader_(begin, end, threads), more_(true)
+        { }
+
+        virtual bool fill(string &buffer, size_t amount)
+        {
+            while (buffer.size() < amount)
+            {
+                if (!this->more_)
+                {
+                    return false;
+                }
+                // Decompress in large enough pieces for all threads to get
+                // a share of the BGZF blocks.
+                this->more_ = this->reader_.read(this->pending_,
+                        std::max(amount, kParallelChunkSize));
+                const char *data = this->pending_.data();
+                const char *split = data + this->pending_.size();
+                if (this->more_)
+                {
+                    split = findLastParagraphStart(data, split);
+                }
+                buffer.append(data, split);
+                this->pending_.erase(0, split - data);
+            }
+            return this->more_;
+        }
+
+    private:
+        GzipReader reader_;
+        string pending_;
+        bool more_;
+};
+
+/*
+** Hands out the paragraphs of a MAF held in memory, split at paragraph
+** boundaries.
+*/
+class MappedParagraphSource: public ParagraphSource
+{
+    public:
+        MappedParagraphSource(const char *begin, const char *end):
+            begin_(begin), pos_(begin), end_(end)
+        { }
+
+        virtual bool fill(string &buffer, size_t amount)
+        {
+            const char *split = this->end_;
+            size_t wanted = amount - std::min(amount, buffer.size());
+            if (size_t(this->end_ - this->pos_) > wanted)
+            {
+                split = findParagraphStart(this->pos_ + wanted, this->begin_,
+                        this->end_);
+            }
+            buffer.append(this->pos_, split);
+            this->pos_ = split;
+            return this->pos_ != this->end_;
+        }
+
+    private:
+        const char *begin_, *pos_, *end_;
+};
+
+// Amount of text passed along the ingestion pipeline at once.
+const size_t kPipelineBatchSize = 1 << 20;
+
+/*
+** A batch of paragraphs travelling through the ingestion pipeline.
+*/
+struct PipelineBatch
+{
+    size_t sequence;
+    string text;
+    vector<ParsedBlock> blocks;
+    std::exception_ptr error;
+};
+
+void discardBatch(PipelineBatch &batch)
+{
+    for (auto it = batch.blocks.begin(); it != batch.blocks.end(); ++it)
+    {
+        discardRows(*it);
+    }
+    batch.blocks.clear();
+    batch.error = std::exception_ptr();
+}
+
+/*
+** Reads a MAF from source through a pipeline of stages connected by
+** bounded queues, so that reading (and decompressing) the input overlaps
+** with parsing it:
+**
+**   - a reader thread fills batches with paragraphs from source,
+**   - tokenizer threads split the paragraphs into row descriptors,
+**   - builder threads build the BitSequences of the rows,
+**
+** and the calling thread merges the batches into wga in input order,
+** resolving sequence IDs. Batches are allocated up front and recycled
+** once merged; when all of them are in flight the reader waits, which
+** bounds the memory used no matter how fast each stage runs.
+*/
+void ReadMafPipelined(ParagraphSource &source, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const ReadOptions &options,
+        StatsCollector &stats)
+{
+    // Building BitSequences takes far longer than tokenizing.
+    size_t tokenizer_count = std::max<size_t>(1, options.threads / 4);
+    size_t builder_count = std::max<size_t>(1,
+            options.threads - tokenizer_count);
+    size_t batch_count = 2 * (tokenizer_count + builder_count) + 2;
+
+    vector<PipelineBatch> batches(batch_count);
+    BoundedQueue<PipelineBatch *> free_batches(batch_count),
+        tokenize_queue(batch_count), build_queue(batch_count);
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+        free_batches.push(&batches[i]);
+    }
+    BlockFilter filter(wga.get_reference(), options);
+
+    std::mutex mutex;
+    std::condition_variable batch_done;
+    // Built batches waiting for their turn to be merged.
+    std::map<size_t, PipelineBatch *> done;
+    size_t batches_read = 0;
+    bool reading_done = false;
+    std::exception_ptr read_error;
+    std::atomic<bool> aborted(false);
+    std::atomic<size_t> tokenizers_running(tokenizer_count);
+
+    auto reader = [&]()
+    {
+        size_t sequence = 0;
+        try
+        {
+            PipelineBatch *batch;
+            bool more = true;
+            while (more && free_batches.pop(batch))
+            {
+                batch->text.clear();
+                more = source.fill(batch->text, kPipelineBatchSize);
+                batch->sequence = sequence;
+                if (!tokenize_queue.push(batch))
+                {
+                    break;
+                }
+                ++sequence;
+            }
+        }
+        catch (...)
+        {
+            read_error = std::current_exception();
+        }
+        tokenize_queue.close();
+        std::lock_guard<std::mutex> lock(mutex);
+        batches_read = sequence;
+        reading_done = true;
+        batch_done.notify_all();
+    };
+
+    auto tokenizer = [&]()
+    {
+        ParseScratch scratch(stats.enabled());
+        PipelineBatch *batch;
+        while (tokenize_queue.pop(batch))
+        {
+            try
+            {
+                const char *pos = batch->text.data();
+                const char *end = pos + batch->text.size();
+                TextRange paragraph;
+                while (!aborted && nextParagraph(pos, end, paragraph))
+                {
+                    scratch.stats.bytes += paragraph.size();
+                    // The block is added first, so that the paragraph
+                    // which fails is always the last one.
+                    batch->blocks.push_back(ParsedBlock());
+                    if (!filter.accepts(paragraph))
+                    {
+                        batch->blocks.pop_back();
+                        continue;
+                    }
+                    tokenizeParagraphRows(paragraph, filter.limit(), scratch,
+                            batch->blocks.back());
+                }
+            }
+            catch (...)
+            {
+                batch->error = std::current_exception();
+            }
+            stats.add(scratch.stats);
+            build_queue.push(batch);
+        }
+        if (--tokenizers_running == 0)
+        {
+            build_queue.close();
+        }
+    };
+
+    auto builder = [&]()
+    {
+        ParseScratch scratch(stats.enabled());
+        PipelineBatch *batch;
+        while (build_queue.pop(batch))
+        {
+            // A block which failed to tokenize is not built.
+            size_t count = batch->blocks.size() - (batch->error ? 1 : 0);
+            size_t i = 0;
+            try
+            {
+                for (; i < count && !aborted; ++i)
+                {
+                    buildBlockRows(batch->blocks[i], factory, scratch);
+                }
+            }
+            catch (...)
+            {
+                batch->error = std::current_exception();
+                // Keep the failed block last, as if tokenizing it failed.
+                for (size_t j = i + 1; j < batch->blocks.size(); ++j)
+                {
+                    discardRows(batch->blocks[j]);
+                }
+                batch->blocks.resize(i + 1);
+            }
+            stats.add(scratch.stats);
+            std::lock_guard<std::mutex> lock(mutex);
+            done[batch->sequence] = batch;
+            batch_done.notify_all();
+        }
+    };
+
+    vector<std::thread> threads;
+    threads.push_back(std::thread(reader));
+    for (size_t i = 0; i < tokenizer_count; ++i)
+    {
+        threads.push_back(std::thread(tokenizer));
+    }
+    for (size_t i = 0; i < builder_count; ++i)
+    {
+        threads.push_back(std::thread(builder));
+    }
+
+    ParseScratch scratch(stats.enabled());
+    try
+    {
+        for (size_t next = 0; ; ++next)
+        {
+            PipelineBatch *batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (done.count(next) == 0
+                        && !(reading_done && next >= batches_read))
+                {
+                    batch_done.wait(lock);
+                }
+                if (done.count(next) == 0)
+                {
+                    break;
+                }
+                batch = done[next];
+                done.erase(next);
+            }
+            // Blocks preceding the error make it into wga, just like they
+            // would when reading sequentially.
+            for (auto it = batch->blocks.begin(); it != batch->blocks.end();
+                    ++it)
+            {
+                if (batch->error && it + 1 == batch->blocks.end())
+                {
+                    break;
+                }
+                wga.addBlock(buildBlock(*it, wga, scratch));
+            }
+            std::exception_ptr error = batch->error;
+            discardBatch(*batch);
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+            free_batches.push(batch);
+            stats.add(scratch.stats);
+            stats.report();
+        }
+        if (read_error)
+        {
+            std::rethrow_exception(read_error);
+        }
+    }
+    catch (...)
+    {
+        aborted = true;
+        free_batches.close();
+        tokenize_queue.close();
+        build_queue.close();
+        for (auto it = threads.begin(); it != threads.end(); ++it)
+        {
+            it->join();
+        }
+        for (auto it = batches.begin(); it != batches.end(); ++it)
+        {
+            discardBatch(*it);
+        }
+        throw;
+    }
+
+    for (auto it = threads.begin(); it != threads.end(); ++it)
+    {
+        it->join();
+    }
+}
+
+AlignmentBlock * ReadMafBlock(const char *begin, const char *end,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory)
+{
+    ParseScratch scratch;
+    ParsedBlock rows;
+    TextRange paragraph;
+    if (!nextParagraph(begin, end, paragraph))
+    {
+        throw ParseError();
+    }
+    return ParseMafParagraph(paragraph, wga, factory, NameLimit(), scratch,
+            rows);
+}
+
+MafIndex * IndexMafFile(const string &file_name, const string &reference)
+{
+    MappedFile file(file_name);
+    MafIndex *index = new MafIndex();
+    index->reference = reference;
+    index->source_size = file.size();
+
+    try
+    {
+        set<string> seen;
+        string name;
+        const char *pos = file.data();
+        TextRange paragraph;
+        while (nextParagraph(pos, file.end(), paragraph))
+        {
+            BlockLocation location;
+            bool has_reference = false;
+            const char *line_pos = paragraph.begin;
+            nextLine(line_pos, paragraph.end);
+            while (line_pos != paragraph.end)
+            {
+                TextRange line = nextLine(line_pos, paragraph.end);
+                if (line.empty() || *line.begin != 's')
+                {
+                    continue;
+                }
+                RowHeader header;
+                parseRowHeader(line, header);
+                name.assign(header.name.begin, header.name.end);
+                if (seen.insert(name).second)
+                {
+                    index->sequences.push_back(std::make_pair(name,
+                                header.src_size));
+                }
+                if (name == reference)
+                {
+                    location.reference_start = header.forwardStart();
+                    location.reference_end = header.forwardLast();
+                    has_reference = true;
+                }
+            }
+            // Blocks without the reference can't be looked up anyway.
+            if (has_reference)
+            {
+                location.offset = paragraph.begin - file.data();
+                location.length = paragraph.size();
+                index->blocks.push_back(location);
+            }
+        }
+    }
+    catch (...)
+    {
+        delete index;
+        throw;
+    }
+
+    // Usually a no-op, MAF files tend to be sorted by the reference.
+    std::stable_sort(index->blocks.begin(), index->blocks.end(),
+            [](const BlockLocation &a, const BlockLocation &b)
+            {
+                return a.reference_start < b.reference_start;
+            });
+    return index;
+}
+
+bool hasSuffix(const string &s, const string &suffix)
+{
+    return s.size() >= suffix.size()
+        && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void ReadMafFile(const string &file_name, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const set<string> *limit)
+{
+    ReadOptions options;
+    options.limit = limit;
+    ReadMafFile(file_name, wga, factory, options);
+}
+
+void ReadMafFile(istream &s, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const set<string> *limit)
+{
+    ReadOptions options;
+    options.limit = limit;
+    ReadMafFile(s, wga, factory, options);
+}
+
+/*
+** Reads a single MAF file, leaving the storage unprepared.
+*/
+void readMafFile(const string &file_name, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const ReadOptions &options,
+        StatsCollector &stats)
+{
+    MappedFile file(file_name);
+    if (GzipReader::isGzip(file.data(), file.end()))
+    {
+        GzipParagraphSource source(file.data(), file.end(),
+                options.threads);
+        if (options.threads > 1)
+        {
+            ReadMafPipelined(source, wga, factory, options, stats);
+        }
+        else
+        {
+            string buffer;
+            bool more = true;
+            while (more)
+            {
+                buffer.clear();
+                more = source.fill(buffer, kStreamBatchSize);
+                ReadMafBuffer(buffer.data(), buffer.data() + buffer.size(),
+                        wga, factory, options, stats);
+            }
+        }
+    }
+    else if (options.threads > 1)
+    {
+        ReadMafBufferParallel(file.data(), file.end(), wga, factory,
+                options, stats);
+    }
+    else
+    {
+        ReadMafBuffer(file.data(), file.end(), wga, factory, options, stats);
+    }
+}
+
+/*
+** The blocks parsed from a piece of one of the files read by
+** ReadMafFiles, waiting to be merged into the alignment.
+*/
+struct FileChunk
+{
+    string text;
+    vector<ParsedBlock> blocks;
+    std::exception_ptr error;
+};
+
+void discardFileChunk(FileChunk *chunk)
+{
+    for (auto it = chunk->blocks.begin(); it != chunk->blocks.end(); ++it)
+    {
+        discardRows(*it);
+    }
+    delete chunk;
+}
+
+// Parsed chunks of a single file held ahead of the merging.
+const size_t kFileQueueLength = 4;
+
+/*
+** Parses everything source produces and hands it over to queue one chunk
+** at a time. Parsing stops at the first error, which is passed along with
+** the chunk it occurred in; the failing block is the last one of that
+** chunk, unless the error comes from source itself, in which case the
+** chunk is empty.
+*/
+void parseMafSource(ParagraphSource &source, BoundedQueue<FileChunk *> &queue,
+        const BlockFilter &filter, BitSequenceFactory &factory,
+        ParseScratch &scratch, StatsCollector &stats)
+{
+    bool more = true;
+    while (more)
+    {
+        FileChunk *chunk = new FileChunk();
+        try
+        {
+            more = source.fill(chunk->text, kParallelChunkSize);
+            const char *pos = chunk->text.data();
+            const char *end = pos + chunk->text.size();
+            TextRange paragraph;
+            while (nextParagraph(pos, end, paragraph))
+            {
+                scratch.stats.bytes += paragraph.size();
+                chunk->blocks.push_back(ParsedBlock());
+                if (!filter.accepts(paragraph))
+                {
+                    chunk->blocks.pop_back();
+                    continue;
+                }
+                parseParagraphRows(paragraph, factory, filter.limit(),
+                        scratch, chunk->blocks.back());
+            }
+        }
+        catch (...)
+        {
+            chunk->error = std::current_exception();
+            more = false;
+        }
+        stats.add(scratch.stats);
+        if (!queue.push(chunk))
+        {
+            discardFileChunk(chunk);
+            return;
+        }
+    }
+}
+
+/*
+** Parses several MAF files at the same time, each of them by a single
+** worker thread. Every file has a queue of its own, which the calling
+** thread drains in the order of files, resolving sequence IDs. Workers
+** take files in order as well, so the file being merged always has a
+** worker; workers ahead of it wait once their queue is full, which bounds
+** the memory used.
+*/
+void ReadMafFilesParallel(const vector<string> &file_names,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory,
+        const ReadOptions &options, StatsCollector &stats)
+{
+    BlockFilter filter(wga.get_reference(), options);
+    vector<BoundedQueue<FileChunk *> *> queues;
+    for (size_t i = 0; i < file_names.size(); ++i)
+    {
+        queues.push_back(new BoundedQueue<FileChunk *>(kFileQueueLength));
+    }
+    std::atomic<size_t> next_file(0);
+    std::atomic<bool> aborted(false);
+
+    auto worker = [&]()
+    {
+        ParseScratch scratch(stats.enabled());
+        size_t i;
+        while (!aborted && (i = next_file++) < file_names.size())
+        {
+            BoundedQueue<FileChunk *> &queue = *queues[i];
+            try
+            {
+                MappedFile file(file_names[i]);
+                if (GzipReader::isGzip(file.data(), file.end()))
+                {
+                    GzipParagraphSource source(file.data(), file.end(), 1);
+                    parseMafSource(source, queue, filter, factory, scratch,
+                            stats);
+                }
+                else
+                {
+                    MappedParagraphSource source(file.data(), file.end());
+                    parseMafSource(source, queue, filter, factory, scratch,
+                            stats);
+                }
+            }
+            catch (...)
+            {
+                // The file could not be opened.
+                FileChunk *chunk = new FileChunk();
+                chunk->error = std::current_exception();
+                if (!queue.push(chunk))
+                {
+                    discardFileChunk(chunk);
+                }
+            }
+            queue.close();
+        }
+    };
+
+    vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(options.threads, file_names.size());
+            ++i)
+    {
+        workers.push_back(std::thread(worker));
+    }
+
+    ParseScratch scratch(stats.enabled());
+    FileChunk *chunk = NULL;
+    try
+    {
+        for (size_t i = 0; i < file_names.size(); ++i)
+        {
+            while (queues[i]->pop(chunk))
+            {
+                // Blocks preceding the error make it into wga, just like
+                // they would when reading sequentially.
+                for (auto it = chunk->blocks.begin();
+                        it != chunk->blocks.end(); ++it)
+                {
+                    if (chunk->error && it + 1 == chunk->blocks.end())
+                    {
+                        break;
+                    }
+                    wga.addBlock(buildBlock(*it, wga, scratch));
+                }
+                std::exception_ptr error = chunk->error;
+                discardFileChunk(chunk);
+                chunk = NULL;
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+                stats.add(scratch.stats);
+                stats.report();
+            }
+        }
+    }
+    catch (...)
+    {
+        aborted = true;
+        if (chunk != NULL)
+        {
+            discardFileChunk(chunk);
+        }
+        for (auto it = queues.begin(); it != queues.end(); ++it)
+        {
+            (*it)->close();
+        }
+        for (auto it = workers.begin(); it != workers.end(); ++it)
+        {
+            it->join();
+        }
+        for (auto it = queues.begin(); it != queues.end(); ++it)
+        {
+            while ((*it)->pop(chunk))
+            {
+                discardFileChunk(chunk);
+            }
+            delete *it;
+        }
+        throw;
+    }
+
+    for (auto it = workers.begin(); it != workers.end(); ++it)
+    {
+        it->join();
+    }
+    for (auto it = queues.begin(); it != queues.end(); ++it)
+    {
+        delete *it;
+    }
+}
+
+void ReadMafFile(const string &file_name, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const ReadOptions &options)
+{
+    StatsCollector stats(options);
+    readMafFile(file_name, wga, factory, options, stats);
+    stats.finish(wga.get_storage());
+}
+
+void ReadMafFiles(const vector<string> &file_names,
+        WholeGenomeAlignment &wga, BitSequenceFactory &factory,
+        const ReadOptions &options)
+{
+    StatsCollector stats(options);
+    if (options.threads > 1 && file_names.size() > 1)
+    {
+        ReadMafFilesParallel(file_names, wga, factory, options, stats);
+    }
+    else
+    {
+        // A single file still gets all the threads.
+        for (auto it = file_names.begin(); it != file_names.end(); ++it)
+        {
+            readMafFile(*it, wga, factory, options, stats);
+        }
+    }
+    stats.finish(wga.get_storage());
+}
+
+vector<string> ListMafFiles(const string &directory)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL)
+    {
+        throw FileMappingError();
+    }
+    vector<string> file_names;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        string name = entry->d_name;
+        if (hasSuffix(name, ".maf") || hasSuffix(name, ".maf.gz"))
+        {
+            file_names.push_back(directory + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(file_names.begin(), file_names.end());
+    return file_names;
+}
+
+void ReadMafFile(istream &s, WholeGenomeAlignment &wga,
+        BitSequenceFactory &factory, const ReadOptions &options)
+{
+    StatsCollector stats(options);
+    if (options.threads > 1)
+    {
+        StreamParagraphSource source(s);
+        ReadMafPipelined(source, wga, factory, options, stats);
+        stats.finish(wga.get_storage());
+        return;
+    }
+
+    string buffer, line;
+    BlockFilter filter(wga.get_reference(), options);
+    ParseScratch scratch(stats.enabled());
+    ParsedBlock rows;
+    while (true)
+    {
+        buffer.clear();
+        if (!readParagraph(s, buffer, line))
+        {
+            break;
+        }
+        const char *data = buffer.data();
+        TextRange paragraph(data, data + buffer.size());
+        scratch.stats.bytes += paragraph.size();
+        if (filter.accepts(paragraph))
+        {
+            wga.addBlock(ParseMafParagraph(paragraph, wga, factory,
+                        filter.limit(), scratch, rows));
+        }
+        stats.add(scratch.stats);
+        stats.report();
+    }
+    stats.finish(wga.get_storage());
+}
+
+
+/*
+** Layout of the blocks collected by BuildMappedAlignment: a SpilledBlock
+** followed by its rows, sorted by ID, each of them a SpilledRow followed
+** by the words of its bits, in the format taken by
+** MappedAlignmentWriter::addRow.
+*/
+struct SpilledBlock
+{
+    uint64_t reference_start, row_count;
+    // Of the whole record, including this header.
+    uint64_t record_size;
+};
+
+struct SpilledRow
+{
+    uint64_t start, src_size, length;
+    uint32_t id, reverse;
+};
+
+/*
+** Position of a record in the run being collected.
+*/
+struct RunEntry
+{
+    uint64_t reference_start;
+    size_t offset;
+
+    bool operator<(const RunEntry &other) const
+    {
+        return this->reference_start < other.reference_start;
+    }
+};
+
+/*
+** Reads back a sorted run of records, either spilled to a file or still
+** held in memory.
+*/
+class RunReader
+{
+    public:
+        RunReader(const string &file_name, size_t buffer_size):
+            buffer_(buffer_size), entries_(NULL), next_entry_(0)
+        {
+            this->file_.rdbuf()->pubsetbuf(&this->buffer_[0],
+                    this->buffer_.size());
+            this->file_.open(file_name.c_str(), std::ios::binary);
+            if (!this->file_.good())
+            {
+                throw SnapshotError();
+            }
+        }
+        RunReader(const vector<char> &records,
+                const vector<RunEntry> &entries):
+            records_(&records), entries_(&entries), next_entry_(0)
+        { }
+
+        /*
+        ** Moves on to the next record; returns false at the end of the
+        ** run.
+        */
+        bool next()
+        {
+            if (this->entries_ != NULL)
+            {
+                if (this->next_entry_ == this->entries_->size())
+                {
+                    return false;
+                }
+                this->current_ = &(*this->records_)[
+                    (*this->entries_)[this->next_entry_++].offset];
+                return true;
+            }
+
+            SpilledBlock block;
+            this->file_.read(reinterpret_cast<char *>(&block),
+                    sizeof(block));
+            if (this->file_.gcount() == 0 && this->file_.eof())
+            {
+                return false;
+            }
+            if (!this->file_.good() || block.record_size < sizeof(block))
+            {
+                throw SnapshotError();
+            }
+            this->record_.resize(block.record_size);
+            memcpy(&this->record_[0], &block, sizeof(block));
+            size_t rest = block.record_size - sizeof(block);
+            this->file_.read(&this->record_[sizeof(block)], rest);
+            if (size_t(this->file_.gcount()) != rest)
+            {
+                throw SnapshotError();
+            }
+            this->current_ = &this->record_[0];
+            return true;
+        }
+
+        const char * record() const
+        {
+            return this->current_;
+        }
+        uint64_t reference_start() const
+        {
+            return reinterpret_cast<const SpilledBlock *>(this->current_)
+                ->reference_start;
+        }
+
+    private:
+        vector<char> buffer_;
+        std::ifstream file_;
+        vector<char> record_;
+        const vector<char> *records_;
+        const vector<RunEntry> *entries_;
+        size_t next_entry_;
+        const char *current_;
+
+        // The following are forbidden.
+        RunReader(const RunReader &);
+        RunReader & operator=(const RunReader &);
+};
+
+/*
+** Collects converted blocks in memory, spilling them to temporary files
+** as sorted runs whenever the budget is exceeded, and merges the runs
+** into an alignment index in the end.
+*/
+class ExternalSorter
+{
+    public:
+        ExternalSorter(const string &output, size_t memory_budget):
+            output_(output),
+            // The rest of the budget is left for merging.
+            run_budget_(std::max<size_t>(memory_budget / 2, 1)),
+            merge_budget_(memory_budget - memory_budget / 2),
+            block_count_(0), row_count_(0), word_count_(0)
+        { }
+        ~ExternalSorter()
+        {
+            for (auto it = this->run_files_.begin();
+                    it != this->run_files_.end(); ++it)
+            {
+                std::remove(it->c_str());
+            }
+        }
+
+        /*
+        ** Returns a buffer to append the record of a block, record_size
+        ** bytes long, to, which has to be followed by a call to commit.
+        ** Spills the blocks collected so far first if the record would
+        ** not fit, so that the buffers never grow past the budget; only a
+        ** single record larger than the budget makes them.
+        */
+        vector<char> & records(size_t record_size)
+        {
+            if (this->records_.capacity() == 0)
+            {
+                this->reserveRun();
+            }
+            if (!this->entries_.empty()
+                    && (this->records_.size() + record_size
+                        > this->records_.capacity()
+                        || this->entries_.size()
+                        == this->entries_.capacity()))
+            {
+                this->spill();
+            }
+            this->record_offset_ = this->records_.size();
+            return this->records_;
+        }
+        void commit(uint64_t reference_start, size_t rows, size_t words)
+        {
+            RunEntry entry;
+            entry.reference_start = reference_start;
+            entry.offset = this->record_offset_;
+            this->entries_.push_back(entry);
+            ++this->block_count_;
+            this->row_count_ += rows;
+            this->word_count_ += words;
+        }
+
+        void finish(const WholeGenomeAlignment &wga)
+        {
+            std::stable_sort(this->entries_.begin(), this->entries_.end());
+            vector<RunReader *> runs;
+            try
+            {
+                size_t buffer_size = std::max<size_t>(1 << 16,
+                        this->merge_budget_ / (this->run_files_.size() + 1));
+                for (auto it = this->run_files_.begin();
+                        it != this->run_files_.end(); ++it)
+                {
+                    runs.push_back(new RunReader(*it, buffer_size));
+                }
+                // The last run never needs to touch the disk.
+                runs.push_back(new RunReader(this->records_,
+                            this->entries_));
+                this->merge(runs, wga);
+            }
+            catch (...)
+            {
+                for (auto it = runs.begin(); it != runs.end(); ++it)
+                {
+                    delete *it;
+                }
+                throw;
+            }
+            for (auto it = runs.begin(); it != runs.end(); ++it)
+            {
+                delete *it;
+            }
+        }
+
+    private:
+        string output_;
+        size_t run_budget_, merge_budget_;
+        vector<char> records_;
+        vector<RunEntry> entries_;
+        size_t record_offset_;
+        vector<string> run_files_;
+        size_t block_count_, row_count_, word_count_;
+
+        /*
+        ** Reserves the buffers of a run within the budget. Each record
+        ** takes at least a block and a row header, which bounds the number
+        ** of entries.
+        */
+        void reserveRun()
+        {
+            size_t entries = this->run_budget_ / (sizeof(RunEntry)
+                    + sizeof(SpilledBlock) + sizeof(SpilledRow)) + 1;
+            this->entries_.reserve(entries);
+            this->records_.reserve(std::max<size_t>(1, this->run_budget_
+                        - std::min(this->run_budget_,
+                            entries * sizeof(RunEntry))));
+        }
+
+        void spill()
+        {
+            std::stable_sort(this->entries_.begin(), this->entries_.end());
+            std::ostringstream name;
+            name << this->output_ << ".run" << this->run_files_.size();
+            this->run_files_.push_back(name.str());
+            std::ofstream out(name.str().c_str(), std::ios::binary);
+            for (auto it = this->entries_.begin(); it != this->entries_.end();
+                    ++it)
+            {
+                const char *record = &this->records_[it->offset];
+                out.write(record, reinterpret_cast<const SpilledBlock *>(
+                            record)->record_size);
+            }
+            out.close();
+            if (!out.good())
+            {
+                throw SnapshotError();
+            }
+            // The buffers are kept for the next run.
+            this->records_.clear();
+            this->entries_.clear();
+        }
+
+        void merge(vector<RunReader *> &runs, const WholeGenomeAlignment &wga)
+        {
+            MappedAlignmentWriter writer(this->output_, this->block_count_,
+                    this->row_count_, this->word_count_);
+            writer.addSequences(wga);
+
+            // Ordered by reference start, then by run, which keeps blocks
+            // starting at the same position in input order.
+            typedef std::pair<uint64_t, size_t> HeapEntry;
+            std::priority_queue<HeapEntry, vector<HeapEntry>,
+                std::greater<HeapEntry> > heap;
+            for (size_t i = 0; i < runs.size(); ++i)
+            {
+                if (runs[i]->next())
+                {
+                    heap.push(HeapEntry(runs[i]->reference_start(), i));
+                }
+            }
+            while (!heap.empty())
+            {
+                size_t index = heap.top().second;
+                RunReader &run = *runs[index];
+                heap.pop();
+                const char *pos = run.record();
+                const SpilledBlock *block =
+                    reinterpret_cast<const SpilledBlock *>(pos);
+                writer.beginBlock(block->reference_start);
+                pos += sizeof(SpilledBlock);
+                for (uint64_t i = 0; i < block->row_count; ++i)
+                {
+                    const SpilledRow *row =
+                        reinterpret_cast<const SpilledRow *>(pos);
+                    pos += sizeof(SpilledRow);
+                    writer.addRow(row->id, row->start, row->reverse != 0,
+                            row->src_size, row->length,
+                            reinterpret_cast<const uint64_t *>(pos));
+                    pos += MappedAlignmentWriter::wordsForLength(row->length)
+                        * sizeof(uint64_t);
+                }
+                if (run.next())
+                {
+                    heap.push(HeapEntry(run.reference_start(), index));
+                }
+            }
+            writer.finish();
+        }
+};
+
+/*
+** Returns the size of the record appendSpilledBlock writes for rows.
+*/
+size_t spilledRecordSize(const ParsedBlock &rows)
+{
+    size_t size = sizeof(SpilledBlock);
+    for (auto it = rows.begin(); it != rows.end(); ++it)
+    {
+        size += sizeof(SpilledRow) + sizeof(uint64_t)
+            * MappedAlignmentWriter::wordsForLength(it->text.size());
+    }
+    return size;
+}
+
+/*
+** Appends the record of a block to records, with the rows sorted by ID.
+** Returns the number of words written.
+*/
+size_t appendSpilledBlock(ParsedBlock &rows, const vector<seqid_t> &ids,
+        uint64_t reference_start, ParseScratch &scratch,
+        vector<char> &records)
+{
+    vector<size_t> order(rows.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+            {
+                return ids[a] < ids[b];
+            });
+
+    size_t record_offset = records.size();
+    SpilledBlock block;
+    block.reference_start = reference_start;
+    block.row_count = rows.size();
+    records.resize(records.size() + sizeof(block));
+
+    size_t total_words = 0;
+    for (auto it = order.begin(); it != order.end(); ++it)
+    {
+        const ParsedRow &parsed = rows[*it];
+        SpilledRow row;
+        row.start = parsed.start;
+        row.src_size = parsed.src_size;
+        row.length = parsed.text.size();
+        row.id = ids[*it];
+        row.reverse = parsed.reverse;
+        const char *data = reinterpret_cast<const char *>(&row);
+        records.insert(records.end(), data, data + sizeof(row));
+
+        {
+            PhaseTimer timer(scratch.timed, scratch.stats.build);
+            scratch.bitstr.reset(row.length);
+            FillNonGapBits(parsed.text.begin, row.length, scratch.bitstr);
+        }
+        size_t words = MappedAlignmentWriter::wordsForLength(row.length);
+        const uint32_t *halves = scratch.bitstr.words();
+        size_t offset = records.size();
+        records.resize(offset + words * sizeof(uint64_t));
+        for (size_t i = 0; i < words; ++i)
+        {
+            uint64_t word = halves[2 * i];
+            if (2 * i + 1 < scratch.bitstr.wordCount())
+            {
+                word |= uint64_t(halves[2 * i + 1]) << 32;
+            }
+            memcpy(&records[offset + i * sizeof(uint64_t)], &word,
+                    sizeof(word));
+        }
+        total_words += words;
+    }
+
+    block.record_size = records.size() - record_offset;
+    memcpy(&records[record_offset], &block, sizeof(block));
+    return total_words;
+}
+
+/*
+** Converts every block produced by source and hands it to sorter.
+*/
+void spillMafSource(ParagraphSource &source, WholeGenomeAlignment &wga,
+        ExternalSorter &sorter, const ReadOptions &options,
+        StatsCollector &stats)
+{
+    BlockFilter filter(wga.get_reference(), options);
+    ParseScratch scratch(stats.enabled());
+    ParsedBlock rows;
+    vector<seqid_t> ids;
+    string text;
+    bool more = true;
+    while (more)
+    {
+        text.clear();
+        more = source.fill(text, kParallelChunkSize);
+        const char *pos = text.data();
+        const char *end = pos + text.size();
+        TextRange paragraph;
+        while (nextParagraph(pos, end, paragraph))
+        {
+            scratch.stats.bytes += paragraph.size();
+            if (!filter.accepts(paragraph))
+            {
+                continue;
+            }
+            rows.clear();
+            tokenizeParagraphRows(paragraph, filter.limit(), scratch, rows);
+
+            // Blocks without the reference can't be looked up anyway.
+            const ParsedRow *reference = NULL;
+            for (auto it = rows.begin(); it != rows.end(); ++it)
+            {
+                if (size_t(it->name.size()) == wga.get_reference().size()
+                        && memcmp(it->name.begin, wga.get_reference().data(),
+                            it->name.size()) == 0)
+                {
+                    reference = &*it;
+                }
+            }
+            if (reference == NULL)
+            {
+                continue;
+            }
+            uint64_t reference_start = reference->reverse
+                ? reference->src_size - reference->start - 1
+                : reference->start;
+
+            ids.clear();
+            for (auto it = rows.begin(); it != rows.end(); ++it)
+            {
+                PhaseTimer timer(scratch.timed, scratch.stats.resolve);
+                ids.push_back(scratch.ids.resolve(it->name, it->src_size,
+                            wga));
+            }
+            size_t words = appendSpilledBlock(rows, ids, reference_start,
+                    scratch, sorter.records(spilledRecordSize(rows)));
+            sorter.commit(reference_start, rows.size(), words);
+            stats.add(scratch.stats);
+            stats.report();
+        }
+    }
+    stats.add(scratch.stats);
+}
+
+void BuildMappedAlignment(const string &file_name, const string &reference,
+        const string &output, size_t memory_budget,
+        const ReadOptions &options)
+{
+    StatsCollector stats(options);
+    // Only used to assign sequence IDs; the blocks are never kept.
+    WholeGenomeAlignment wga(reference, NULL);
+    ExternalSorter sorter(output, memory_budget);
+    MappedFile file(file_name);
+    if (GzipReader::isGzip(file.data(), file.end()))
+    {
+        GzipParagraphSource source(file.data(), file.end(),
+                options.threads);
+        spillMafSource(source, wga, sorter, options, stats);
+    }
+    else
+    {
+        MappedParagraphSource source(file.data(), file.end());
+        spillMafSource(source, wga, sorter, options, stats);
     }
-    catch (std::ios_base::failure &e)
-    { };
+    sorter.finish(wga);
+    stats.finish(NULL);
 }
 
 } /* namespace maf_reader */
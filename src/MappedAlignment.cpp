@@ -0,0 +1,603 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <BitSequence.h>
+
+#include <MappedAlignment.h>
+#include <MappedFile.h>
+#include <WholeGenomeAlignment.h>
+#include <AlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <MultialnConstants.h>
+
+
+using std::string;
+using std::vector;
+using mapped_format::Header;
+using mapped_format::Row;
+using mapped_format::Sequence;
+
+namespace
+{
+
+const size_t kSectionBufferSize = 1 << 20;
+
+// Number of words covered by a single rank sample.
+const size_t kWordsPerSample = 8;
+
+inline size_t popcount(uint64_t word)
+{
+    return __builtin_popcountll(word);
+}
+
+/*
+** Tells whether count elements of the given size, starting at offset,
+** end no later than end. Arrays have to start at a multiple of 8 bytes.
+*/
+bool sectionFits(uint64_t offset, uint64_t count, uint64_t element_size,
+        uint64_t end)
+{
+    return offset % 8 == 0 && offset <= end
+        && count <= (end - offset) / element_size;
+}
+
+/*
+** Orders the sequence table by name; the names live in a separate pool.
+*/
+class SequenceNameLess
+{
+    public:
+        SequenceNameLess(const char *names):
+            names_(names)
+        { }
+        bool operator()(const Sequence &a, const Sequence &b) const
+        {
+            int result = memcmp(this->names_ + a.name_offset,
+                    this->names_ + b.name_offset,
+                    std::min(a.name_length, b.name_length));
+            return result < 0
+                || (result == 0 && a.name_length < b.name_length);
+        }
+
+    private:
+        const char *names_;
+};
+
+} /* namespace */
+
+
+MappedAlignmentWriter::Section::Section(int fd, uint64_t offset):
+    fd_(fd), offset_(offset)
+{
+    this->buffer_.reserve(kSectionBufferSize);
+}
+
+MappedAlignmentWriter::Section::~Section()
+{ }
+
+void MappedAlignmentWriter::Section::write(const void *data, size_t length)
+{
+    const char *bytes = static_cast<const char *>(data);
+    if (this->buffer_.size() + length > kSectionBufferSize)
+    {
+        this->flush();
+    }
+    this->buffer_.insert(this->buffer_.end(), bytes, bytes + length);
+}
+
+void MappedAlignmentWriter::Section::flush()
+{
+    size_t written = 0;
+    while (written < this->buffer_.size())
+    {
+        ssize_t result = pwrite(this->fd_, &this->buffer_[written],
+                this->buffer_.size() - written, this->offset_ + written);
+        if (result <= 0)
+        {
+            throw SnapshotError();
+        }
+        written += result;
+    }
+    this->offset_ += written;
+    this->buffer_.clear();
+}
+
+MappedAlignmentWriter::MappedAlignmentWriter(const string &file_name,
+        size_t block_count, size_t row_count, size_t word_count):
+    block_starts_(NULL), block_rows_(NULL), rows_(NULL), bits_(NULL),
+    rank_samples_(NULL), blocks_added_(0), rows_added_(0), words_added_(0),
+    ones_added_(0)
+{
+    this->fd_ = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (this->fd_ < 0)
+    {
+        throw SnapshotError();
+    }
+
+    memset(&this->header_, 0, sizeof(this->header_));
+    Header &h = this->header_;
+    h.magic = mapped_format::kMagic;
+    h.version = mapped_format::kVersion;
+    h.block_count = block_count;
+    h.row_count = row_count;
+    h.word_count = word_count;
+    h.block_starts_offset = sizeof(Header);
+    h.block_rows_offset = h.block_starts_offset + block_count * 8;
+    h.rows_offset = h.block_rows_offset + (block_count + 1) * 8;
+    h.bits_offset = h.rows_offset + row_count * sizeof(Row);
+    h.rank_samples_offset = h.bits_offset + word_count * 8;
+    h.sequences_offset = h.rank_samples_offset
+        + (word_count / kWordsPerSample + 1) * 8;
+
+    this->block_starts_ = new Section(this->fd_, h.block_starts_offset);
+    this->block_rows_ = new Section(this->fd_, h.block_rows_offset);
+    this->rows_ = new Section(this->fd_, h.rows_offset);
+    this->bits_ = new Section(this->fd_, h.bits_offset);
+    this->rank_samples_ = new Section(this->fd_, h.rank_samples_offset);
+}
+
+MappedAlignmentWriter::~MappedAlignmentWriter()
+{
+    delete this->block_starts_;
+    delete this->block_rows_;
+    delete this->rows_;
+    delete this->bits_;
+    delete this->rank_samples_;
+    close(this->fd_);
+}
+
+void MappedAlignmentWriter::addSequence(seqid_t id, const string &name,
+        size_t size)
+{
+    Sequence sequence;
+    memset(&sequence, 0, sizeof(sequence));
+    sequence.name_offset = this->names_.size();
+    sequence.name_length = name.size();
+    sequence.size = size;
+    sequence.id = id;
+    this->sequences_.push_back(sequence);
+    this->names_ += name;
+    if (id == kReferenceSequenceId)
+    {
+        this->header_.reference_size = size;
+    }
+}
+
+void MappedAlignmentWriter::beginBlock(size_t reference_start)
+{
+    uint64_t value = reference_start;
+    this->block_starts_->write(&value, sizeof(value));
+    this->block_rows_->write(&this->rows_added_, sizeof(this->rows_added_));
+    ++this->blocks_added_;
+}
+
+void MappedAlignmentWriter::addRow(seqid_t id, size_t start, bool reverse,
+        size_t src_size, size_t length, const uint64_t *words)
+{
+    // Lengths are stored in 32 bits; the number of ones can't exceed it.
+    if (length > std::numeric_limits<uint32_t>::max())
+    {
+        throw SnapshotError();
+    }
+    Row row;
+    memset(&row, 0, sizeof(row));
+    row.start = start;
+    row.src_size = src_size;
+    row.first_word = this->words_added_;
+    row.length = length;
+    row.id = id;
+    row.reverse = reverse;
+
+    size_t word_count = wordsForLength(length);
+    for (size_t i = 0; i < word_count; ++i)
+    {
+        if (this->words_added_ % kWordsPerSample == 0)
+        {
+            this->rank_samples_->write(&this->ones_added_,
+                    sizeof(this->ones_added_));
+        }
+        uint64_t word = words[i];
+        // Make sure no stray bits past the end of the row get counted.
+        if (i + 1 == word_count && length % 64 != 0)
+        {
+            word &= (uint64_t(1) << (length % 64)) - 1;
+        }
+        this->bits_->write(&word, sizeof(word));
+        row.ones += popcount(word);
+        this->ones_added_ += popcount(word);
+        ++this->words_added_;
+    }
+
+    this->rows_->write(&row, sizeof(row));
+    ++this->rows_added_;
+}
+
+void MappedAlignmentWriter::finish()
+{
+    Header &h = this->header_;
+    if (this->blocks_added_ != h.block_count
+            || this->rows_added_ != h.row_count
+            || this->words_added_ != h.word_count)
+    {
+        throw SnapshotError();
+    }
+    // Terminate the row index of the last block and the rank samples.
+    this->block_rows_->write(&this->rows_added_, sizeof(this->rows_added_));
+    if (this->words_added_ % kWordsPerSample == 0)
+    {
+        this->rank_samples_->write(&this->ones_added_,
+                sizeof(this->ones_added_));
+    }
+
+    std::sort(this->sequences_.begin(), this->sequences_.end(),
+            SequenceNameLess(this->names_.data()));
+    h.sequence_count = this->sequences_.size();
+    h.names_offset = h.sequences_offset
+        + this->sequences_.size() * sizeof(Sequence);
+    h.file_size = h.names_offset + this->names_.size();
+
+    Section sequences(this->fd_, h.sequences_offset);
+    if (!this->sequences_.empty())
+    {
+        sequences.write(&this->sequences_[0],
+                this->sequences_.size() * sizeof(Sequence));
+    }
+    sequences.write(this->names_.data(), this->names_.size());
+    sequences.flush();
+
+    this->block_starts_->flush();
+    this->block_rows_->flush();
+    this->rows_->flush();
+    this->bits_->flush();
+    this->rank_samples_->flush();
+
+    // The header goes last, so that an interrupted write never leaves
+    // behind a file which looks valid.
+    Section header(this->fd_, 0);
+    header.write(&h, sizeof(h));
+    header.flush();
+}
+
+void MappedAlignmentWriter::addSequences(const WholeGenomeAlignment &wga)
+{
+    vector<string> *names = wga.getSequenceList();
+    for (auto it = names->begin(); it != names->end(); ++it)
+    {
+        seqid_t id = wga.getSequenceId(*it);
+        size_t size = 0;
+        try
+        {
+            size = wga.getSequenceSize(id);
+        }
+        // The reference is known by name even if it has no blocks.
+        catch (SequenceDoesNotExist &e)
+        { }
+        this->addSequence(id, *it, size);
+    }
+    delete names;
+}
+
+void WriteMappedAlignment(WholeGenomeAlignment &wga, const string &file_name)
+{
+    AlignmentBlockStorage *storage = wga.get_storage();
+    size_t row_count = 0, word_count = 0;
+    for (AlignmentBlockStorage::iterator it = storage->begin();
+            it != storage->end(); ++it)
+    {
+        const AlignmentBlock::Rows &rows = it->getSequences();
+        row_count += rows.size();
+        for (auto row = rows.begin(); row != rows.end(); ++row)
+        {
+            word_count += MappedAlignmentWriter::wordsForLength(
+                    row->get_sequence()->getLength());
+        }
+    }
+
+    MappedAlignmentWriter writer(file_name, storage->size(), row_count,
+            word_count);
+
+    writer.addSequences(wga);
+
+    vector<uint64_t> words;
+    for (AlignmentBlockStorage::iterator it = storage->begin();
+            it != storage->end(); ++it)
+    {
+        writer.beginBlock(it->getReferenceSequence()->get_start());
+        const AlignmentBlock::Rows &rows = it->getSequences();
+        for (auto row = rows.begin(); row != rows.end(); ++row)
+        {
+            const cds_static::BitSequence *bits = row->get_sequence();
+            size_t length = bits->getLength();
+            words.assign(MappedAlignmentWriter::wordsForLength(length), 0);
+            for (size_t i = 0; i < length; ++i)
+            {
+                if (bits->access(i))
+                {
+                    words[i / 64] |= uint64_t(1) << (i % 64);
+                }
+            }
+            // SequenceDetails only hands out the forward strand start.
+            size_t start = row->get_start();
+            if (row->is_reverse())
+            {
+                start = row->get_src_size() - start - 1;
+            }
+            writer.addRow(row->get_id(), start, row->is_reverse(),
+                    row->get_src_size(), length,
+                    words.empty() ? NULL : &words[0]);
+        }
+    }
+    writer.finish();
+}
+
+
+MappedAlignment::MappedAlignment(const string &file_name):
+    file_(file_name, MappedFile::ACCESS_RANDOM)
+{
+    if (this->file_.size() < sizeof(Header))
+    {
+        throw SnapshotError();
+    }
+    const char *base = this->file_.data();
+    this->header_ = reinterpret_cast<const Header *>(base);
+    const Header &h = *this->header_;
+    if (h.magic != mapped_format::kMagic
+            || h.version != mapped_format::kVersion
+            || h.file_size != this->file_.size())
+    {
+        throw SnapshotError();
+    }
+    this->checkSections();
+
+    this->block_starts_ = reinterpret_cast<const uint64_t *>(
+            base + h.block_starts_offset);
+    this->block_rows_ = reinterpret_cast<const uint64_t *>(
+            base + h.block_rows_offset);
+    this->rows_ = reinterpret_cast<const Row *>(base + h.rows_offset);
+    this->bits_ = reinterpret_cast<const uint64_t *>(base + h.bits_offset);
+    this->rank_samples_ = reinterpret_cast<const uint64_t *>(
+            base + h.rank_samples_offset);
+    this->sequences_ = reinterpret_cast<const Sequence *>(
+            base + h.sequences_offset);
+    this->names_ = base + h.names_offset;
+}
+
+void MappedAlignment::checkSections() const
+{
+    const Header &h = *this->header_;
+    // Each section has to end before the next one starts. block_count is
+    // compared to the file size first, so that adding one can't wrap.
+    if (h.block_starts_offset < sizeof(Header)
+            || h.block_count >= h.file_size
+            || !sectionFits(h.block_starts_offset, h.block_count, 8,
+                h.block_rows_offset)
+            || !sectionFits(h.block_rows_offset, h.block_count + 1, 8,
+                h.rows_offset)
+            || !sectionFits(h.rows_offset, h.row_count, sizeof(Row),
+                h.bits_offset)
+            || !sectionFits(h.bits_offset, h.word_count, 8,
+                h.rank_samples_offset)
+            || !sectionFits(h.rank_samples_offset,
+                h.word_count / kWordsPerSample + 1, 8, h.sequences_offset)
+            || !sectionFits(h.sequences_offset, h.sequence_count,
+                sizeof(Sequence), h.names_offset)
+            || h.names_offset > h.file_size)
+    {
+        throw SnapshotError();
+    }
+}
+
+const Row & MappedAlignment::checkRow(const Row &row) const
+{
+    const Header &h = *this->header_;
+    if (row.first_word > h.word_count
+            || MappedAlignmentWriter::wordsForLength(row.length)
+                > h.word_count - row.first_word
+            || row.ones > row.length)
+    {
+        throw SnapshotError();
+    }
+    return row;
+}
+
+const Sequence & MappedAlignment::checkSequence(
+        const Sequence &sequence) const
+{
+    uint64_t names_size = this->header_->file_size
+        - this->header_->names_offset;
+    if (sequence.name_offset > names_size
+            || sequence.name_length > names_size - sequence.name_offset)
+    {
+        throw SnapshotError();
+    }
+    return sequence;
+}
+
+size_t MappedAlignment::mapPositionToInformant(size_t position,
+        const string &informant, IntervalBoundary boundary) const
+{
+    const uint64_t *starts_end = this->block_starts_
+        + this->header_->block_count;
+    size_t block = std::upper_bound(this->block_starts_, starts_end,
+            position) - this->block_starts_;
+    if (block == 0)
+    {
+        throw OutOfSequence();
+    }
+    --block;
+
+    const Row *reference = this->findRow(block, kReferenceSequenceId);
+    if (reference == NULL)
+    {
+        throw SequenceDoesNotExist();
+    }
+    size_t alignment_pos = this->sequenceToAlignment(*reference, position);
+
+    const Row *row = this->findRow(block, this->getSequenceId(informant));
+    if (row == NULL)
+    {
+        throw SequenceDoesNotExist();
+    }
+    return this->alignmentToSequence(*row, alignment_pos, boundary);
+}
+
+seqid_t MappedAlignment::getSequenceId(const string &name) const
+{
+    size_t start = 0, end = this->header_->sequence_count;
+    while (start < end)
+    {
+        size_t middle = (start + end) / 2;
+        const Sequence &sequence = this->checkSequence(
+                this->sequences_[middle]);
+        int result = memcmp(this->names_ + sequence.name_offset,
+                name.data(), std::min<size_t>(sequence.name_length,
+                    name.size()));
+        if (result == 0 && sequence.name_length == name.size())
+        {
+            return sequence.id;
+        }
+        if (result < 0
+                || (result == 0 && sequence.name_length < name.size()))
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+    throw SequenceDoesNotExist();
+}
+
+const Row * MappedAlignment::findRow(size_t block, seqid_t id) const
+{
+    size_t start = this->block_rows_[block],
+           end = this->block_rows_[block + 1];
+    if (start > end || end > this->header_->row_count)
+    {
+        throw SnapshotError();
+    }
+    while (start < end)
+    {
+        size_t middle = (start + end) / 2;
+        if (this->rows_[middle].id == id)
+        {
+            return &this->checkRow(this->rows_[middle]);
+        }
+        if (this->rows_[middle].id < id)
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+    return NULL;
+}
+
+size_t MappedAlignment::rank(const Row &row, size_t count) const
+{
+    // Count the ones between the closest sample and either end, and take
+    // the difference.
+    size_t result = 0;
+    size_t position = row.first_word * 64;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        size_t word = position / 64;
+        size_t first = word / kWordsPerSample * kWordsPerSample;
+        size_t ones = this->rank_samples_[first / kWordsPerSample];
+        for (size_t i = first; i < word; ++i)
+        {
+            ones += popcount(this->bits_[i]);
+        }
+        if (position % 64 != 0)
+        {
+            ones += popcount(this->bits_[word]
+                    & ((uint64_t(1) << (position % 64)) - 1));
+        }
+        result = ones - result;
+        position += count;
+    }
+    return result;
+}
+
+size_t MappedAlignment::select(const Row &row, size_t index) const
+{
+    // Rows are short, a scan over their words is cheaper than a search
+    // over the samples.
+    const uint64_t *word = this->bits_ + row.first_word;
+    const uint64_t *last = word
+        + MappedAlignmentWriter::wordsForLength(row.length);
+    size_t ones;
+    while (word != last && (ones = popcount(*word)) < index)
+    {
+        index -= ones;
+        ++word;
+    }
+    // Only possible if the stored number of ones is wrong.
+    if (word == last)
+    {
+        throw SnapshotError();
+    }
+    uint64_t bits = *word;
+    for (size_t i = 1; i < index; ++i)
+    {
+        bits &= bits - 1;
+    }
+    return (word - this->bits_ - row.first_word) * 64
+        + __builtin_ctzll(bits);
+}
+
+size_t MappedAlignment::sequenceToAlignment(const Row &row,
+        size_t index) const
+{
+    if (row.reverse)
+    {
+        index = row.src_size - index - 1;
+    }
+    if (index < row.start || index >= row.start + row.ones)
+    {
+        throw OutOfSequence();
+    }
+    return this->select(row, index - row.start + 1);
+}
+
+size_t MappedAlignment::alignmentToSequence(const Row &row, size_t index,
+        IntervalBoundary boundary) const
+{
+    if (index >= row.length)
+    {
+        throw OutOfSequence();
+    }
+    size_t rank = this->rank(row, index + 1);
+    bool filled = (this->bits_[row.first_word + index / 64]
+            >> (index % 64)) & 1;
+    if (!filled)
+    {
+        if (boundary == INTERVAL_BEGIN)
+        {
+            ++rank;
+        }
+        // rank can be 0 iff boundary is INTERVAL_END and the sought
+        // position is before our block.
+        if (rank == 0 || rank > row.ones)
+        {
+            throw OutOfSequence();
+        }
+    }
+    size_t position = rank + row.start - 1;
+    if (row.reverse)
+    {
+        position = row.src_size - position - 1;
+    }
+    return position;
+}
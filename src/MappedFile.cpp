@@ -0,0 +1,52 @@
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <MappedFile.h>
+
+
+MappedFile::MappedFile(const std::string &file_name, AccessPattern pattern):
+    data_(NULL), size_(0)
+{
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw FileMappingError();
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw FileMappingError();
+    }
+    this->size_ = info.st_size;
+
+    // mmap refuses zero-length mappings; an empty file simply has no
+    // contents.
+    if (this->size_ > 0)
+    {
+        void *addr = mmap(NULL, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            throw FileMappingError();
+        }
+        madvise(addr, this->size_, (pattern == ACCESS_SEQUENTIAL) ?
+                MADV_SEQUENTIAL : MADV_RANDOM);
+        this->data_ = static_cast<const char *>(addr);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (this->data_ != NULL)
+    {
+        munmap(const_cast<char *>(this->data_), this->size_);
+    }
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+
+#include <OverlapAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+// Subtrees up to this level are scanned rather than descended into.
+const unsigned kScanLevel = 3;
+
+} /* namespace */
+
+AlignmentBlock * OverlapAlignmentBlockStorage::getBlock(const size_t pos)
+{
+    if (this->contents_.empty())
+    {
+        throw OutOfSequence();
+    }
+
+    this->prepare();
+    size_t last;
+    if (this->visitCovering(pos, NULL, last) == 0)
+    {
+        throw OutOfSequence();
+    }
+    return this->contents_[last];
+}
+
+AlignmentBlock * OverlapAlignmentBlockStorage::getBlockNear(
+        const size_t pos, QueryCursor &)
+{
+    // Galloping over starts alone could miss a longer block starting
+    // further back.
+    return this->getBlock(pos);
+}
+
+size_t OverlapAlignmentBlockStorage::findAll(const size_t pos,
+        std::vector<AlignmentBlock *> &blocks)
+{
+    blocks.clear();
+    if (this->contents_.empty())
+    {
+        return 0;
+    }
+
+    this->prepare();
+    size_t last;
+    return this->visitCovering(pos, &blocks, last);
+}
+
+size_t OverlapAlignmentBlockStorage::findIndex(const size_t pos)
+{
+    size_t index = std::upper_bound(this->starts_.begin(),
+            this->starts_.end(), pos) - this->starts_.begin();
+    if (index == 0)
+    {
+        throw OutOfSequence();
+    }
+    return index - 1;
+}
+
+/*
+** Element i of the sorted array sits at the level given by the number of
+** trailing ones in i, and the children of an element x at level k > 0
+** are x - 2^(k-1) and x + 2^(k-1). Elements past the end are missing but
+** their left subtrees are not, so the largest end among the rightmost
+** elements is carried along in last.
+*/
+void OverlapAlignmentBlockStorage::buildIndex()
+{
+    size_t count = this->contents_.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    this->collectStarts(this->starts_);
+    this->ends_.resize(count);
+    ForEachRange(count, this->threads_, [this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            this->ends_[i] = this->starts_[i] + this->contents_[i]
+                ->getReferenceSequence()->get_size();
+        }
+    });
+
+    std::vector<size_t> &max_ends = this->max_ends_;
+    max_ends.resize(count);
+    size_t last_index = 0, last = 0;
+    for (size_t i = 0; i < count; i += 2)
+    {
+        last_index = i;
+        last = max_ends[i] = this->ends_[i];
+    }
+    unsigned level = 1;
+    for (; (size_t(1) << level) <= count; ++level)
+    {
+        // The elements of a level only depend on the level below.
+        size_t half = size_t(1) << (level - 1);
+        size_t first = 2 * half - 1, step = 4 * half;
+        size_t elements = (count - first + step - 1) / step;
+        ForEachRange(elements, this->threads_, [&, half, first, step,
+                last](size_t begin, size_t end)
+        {
+            for (size_t i = first + begin * step; i < first + end * step
+                    && i < count; i += step)
+            {
+                size_t right = (i + half < count) ? max_ends[i + half]
+                    : last;
+                max_ends[i] = std::max(this->ends_[i],
+                        std::max(max_ends[i - half], right));
+            }
+        });
+        last_index = ((last_index >> level) & 1) ? last_index - half
+            : last_index + half;
+        if (last_index < count && max_ends[last_index] > last)
+        {
+            last = max_ends[last_index];
+        }
+    }
+    this->root_level_ = level - 1;
+}
+
+void OverlapAlignmentBlockStorage::dropIndex()
+{
+    std::vector<size_t>().swap(this->starts_);
+    std::vector<size_t>().swap(this->ends_);
+    std::vector<size_t>().swap(this->max_ends_);
+    this->root_level_ = 0;
+}
+
+size_t OverlapAlignmentBlockStorage::visitCovering(const size_t pos,
+        std::vector<AlignmentBlock *> *blocks, size_t &last) const
+{
+    struct Frame
+    {
+        size_t node;
+        unsigned level;
+        // Whether the left subtree has been dealt with already.
+        bool left_done;
+    };
+    // Each level leaves at most one frame behind.
+    Frame stack[2 * sizeof(size_t) * 8];
+    size_t depth = 0, found = 0, count = this->starts_.size();
+
+    Frame root = {(size_t(1) << this->root_level_) - 1, this->root_level_,
+        false};
+    stack[depth++] = root;
+    while (depth > 0)
+    {
+        Frame frame = stack[--depth];
+        if (frame.level <= kScanLevel)
+        {
+            // Small subtrees are cheaper to scan in order.
+            size_t first = frame.node >> frame.level << frame.level;
+            size_t end = std::min(count,
+                    first + (size_t(2) << frame.level) - 1);
+            for (size_t i = first; i < end && this->starts_[i] <= pos; ++i)
+            {
+                if (pos < this->ends_[i])
+                {
+                    ++found;
+                    last = i;
+                    if (blocks != NULL)
+                    {
+                        blocks->push_back(this->contents_[i]);
+                    }
+                }
+            }
+        }
+        else if (!frame.left_done)
+        {
+            size_t left = frame.node - (size_t(1) << (frame.level - 1));
+            frame.left_done = true;
+            stack[depth++] = frame;
+            if (left >= count || this->max_ends_[left] > pos)
+            {
+                Frame child = {left, frame.level - 1, false};
+                stack[depth++] = child;
+            }
+        }
+        else if (frame.node < count && this->starts_[frame.node] <= pos)
+        {
+            if (pos < this->ends_[frame.node])
+            {
+                ++found;
+                last = frame.node;
+                if (blocks != NULL)
+                {
+                    blocks->push_back(this->contents_[frame.node]);
+                }
+            }
+            Frame child = {frame.node + (size_t(1) << (frame.level - 1)),
+                frame.level - 1, false};
+            stack[depth++] = child;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include <Parallel.h>
+
+
+void RunTasks(size_t count, const std::function<void (size_t)> &task)
+{
+    if (count == 1)
+    {
+        task(0);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> threads;
+    std::exception_ptr start_error;
+    try
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            threads.push_back(std::thread([&task, &errors, i]()
+            {
+                try
+                {
+                    task(i);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            }));
+        }
+    }
+    catch (...)
+    {
+        // Threads already running have to be joined either way.
+        start_error = std::current_exception();
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    if (start_error)
+    {
+        std::rethrow_exception(start_error);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (errors[i])
+        {
+            std::rethrow_exception(errors[i]);
+        }
+    }
+}
+
+std::vector<size_t> SplitRanges(size_t count, size_t threads,
+        size_t min_length)
+{
+    size_t parts = std::max<size_t>(1, std::min(threads,
+                count / std::max<size_t>(1, min_length)));
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= parts; ++i)
+    {
+        bounds.push_back(count / parts * i + std::min(i, count % parts));
+    }
+    return bounds;
+}
+
+void ForEachRange(size_t count, size_t threads,
+        const std::function<void (size_t, size_t)> &work, size_t min_length)
+{
+    std::vector<size_t> bounds = SplitRanges(count, threads, min_length);
+    RunTasks(bounds.size() - 1, [&bounds, &work](size_t i)
+    {
+        work(bounds[i], bounds[i + 1]);
+    });
+}
@@ -1,4 +1,5 @@
-#include <algorithm>
+#include <vector>
+#include <fstream>
 #include <BitString.h>
 #include <BitSequence.h>
 
@@ -13,30 +14,22 @@ using cds_static::BitSequenceRRR;
 
 RankAlignmentBlockStorage::~RankAlignmentBlockStorage()
 {
-    for (size_t i = 0; i < this->contents_.size(); ++i)
-    {
-        delete this->contents_[i];
-    }
     delete this->index_;
 }
 
-void RankAlignmentBlockStorage::addBlock(AlignmentBlock *block)
+size_t RankAlignmentBlockStorage::findIndex(const size_t pos)
 {
-    this->unprepare();
-    this->contents_.push_back(block);
-}
-
-RankAlignmentBlockStorage::iterator
-RankAlignmentBlockStorage::find(const size_t pos)
-{
-    if (this->contents_.empty())
+    if (pos < this->base_)
     {
         throw OutOfSequence();
     }
-
-    this->prepare();
-
-    size_t index = this->index_->rank1(pos);
+    // Everything past the last start belongs to the last block.
+    size_t offset = pos - this->base_;
+    size_t index = this->contents_.size();
+    if (offset < this->index_->getLength())
+    {
+        index = this->index_->rank1(offset);
+    }
     if (index == 0 || index > this->contents_.size())
     {
         throw OutOfSequence();
@@ -44,57 +37,63 @@ RankAlignmentBlockStorage::find(const size_t pos)
 
     --index;
 
-    return
-        iterator(IteratorImplementation(this->contents_.begin() + index));
-}
-
-RankAlignmentBlockStorage::iterator
-RankAlignmentBlockStorage::begin()
-{
-    this->prepare();
-    return iterator(IteratorImplementation(this->contents_.begin()));
+    return index;
 }
 
-RankAlignmentBlockStorage::iterator
-RankAlignmentBlockStorage::end()
+void RankAlignmentBlockStorage::saveIndex(std::ofstream &fp)
 {
-    this->prepare();
-    return iterator(IteratorImplementation(this->contents_.end()));
+    if (!this->contents_.empty())
+    {
+        cds_utils::saveValue(fp, this->base_);
+        this->index_->save(fp);
+    }
 }
 
-size_t RankAlignmentBlockStorage::size() const
+void RankAlignmentBlockStorage::loadIndex(std::ifstream &fp)
 {
-    return this->contents_.size();
+    if (this->contents_.empty())
+    {
+        return;
+    }
+    size_t base = cds_utils::loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    BitSequence *index = BitSequence::load(fp);
+    if (index == NULL)
+    {
+        throw SnapshotError();
+    }
+    // The blocks have been saved sorted, which makes the index valid.
+    this->index_ = index;
+    this->base_ = base;
+    this->index_loaded_ = true;
 }
 
-void RankAlignmentBlockStorage::unprepare()
+void RankAlignmentBlockStorage::dropIndex()
 {
-    this->prepared_ = false;
     delete this->index_;
     this->index_ = NULL;
+    this->base_ = 0;
 }
 
-void RankAlignmentBlockStorage::prepare()
+void RankAlignmentBlockStorage::buildIndex()
 {
-    if (this->prepared_)
+    if (this->contents_.empty())
     {
         return;
     }
-    std::sort(this->contents_.begin(), this->contents_.end(),
-            AlignmentBlock::compareReferencePosition);
-
-    size_t reference_size =
-        this->contents_[0]->getReferenceSequence()->get_src_size();
-    // add a padding to make sure we don't exceed it on boundary
-    reference_size += 47;
 
-    BitString bitstr(reference_size);
-    for (auto it = this->contents_.begin(); it != this->contents_.end(); ++it)
+    // The starts are sorted, so the bitmap only has to cover the first
+    // to the last one.
+    std::vector<size_t> starts;
+    this->collectStarts(starts);
+    this->base_ = starts.front();
+    BitString bitstr(starts.back() - this->base_ + 1);
+    for (auto it = starts.begin(); it != starts.end(); ++it)
     {
-        size_t position = (*it)->getReferenceSequence()->get_start();
-        bitstr.setBit(position, 1);
+        bitstr.setBit(*it - this->base_, 1);
     }
     this->index_ = new BitSequenceRRR(bitstr);
-
-    this->prepared_ = true;
 }
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREE_X86
+#include <immintrin.h>
+#endif
+
+#include <STreeAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+const size_t kKeys = STreeAlignmentBlockStorage::kKeysPerNode;
+const int64_t kNoKey = std::numeric_limits<int64_t>::max();
+
+// Returns the number of keys of a node not greater than pos; keys within
+// a node are sorted, so these are the first ones.
+typedef size_t (*NodeRankKernel)(const int64_t *node, int64_t pos);
+
+size_t rankScalar(const int64_t *node, int64_t pos)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < kKeys; ++i)
+    {
+        count += (node[i] <= pos);
+    }
+    return count;
+}
+
+#ifdef STREE_X86
+
+__attribute__((target("avx2,popcnt")))
+size_t rankAVX2(const int64_t *node, int64_t pos)
+{
+    const __m256i x = _mm256_set1_epi64x(pos);
+    __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i *>(node));
+    __m256i high = _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(node + 4));
+    unsigned greater =
+        unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(
+                        _mm256_cmpgt_epi64(low, x))))
+        | (unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(
+                            _mm256_cmpgt_epi64(high, x)))) << 4);
+    return kKeys - _mm_popcnt_u32(greater);
+}
+
+#endif /* STREE_X86 */
+
+NodeRankKernel selectKernel()
+{
+#ifdef STREE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    {
+        return rankAVX2;
+    }
+#endif
+    return rankScalar;
+}
+
+// Index of the i-th child of node.
+inline size_t child(size_t node, size_t i)
+{
+    return node * (kKeys + 1) + i + 1;
+}
+
+} /* namespace */
+
+STreeAlignmentBlockStorage::~STreeAlignmentBlockStorage()
+{
+    free(this->keys_);
+}
+
+size_t STreeAlignmentBlockStorage::findIndex(const size_t pos)
+{
+    static const NodeRankKernel rank = selectKernel();
+    // Positions beyond any key are all greater than the last block start.
+    int64_t key = (pos >= size_t(kNoKey)) ? kNoKey - 1 : int64_t(pos);
+
+    // Find the first start greater than pos, the block preceding it is
+    // the one we are after.
+    size_t found = this->contents_.size();
+    size_t node = 0;
+    while (node < this->node_count_)
+    {
+        const int64_t *keys = this->keys_ + node * kKeys;
+        size_t i = rank(keys, key);
+        if (i < kKeys)
+        {
+            found = this->blocks_[node * kKeys + i];
+        }
+        node = child(node, i);
+    }
+
+    if (found == 0)
+    {
+        throw OutOfSequence();
+    }
+    return found - 1;
+}
+
+void STreeAlignmentBlockStorage::buildIndex()
+{
+    size_t count = this->contents_.size();
+    this->node_count_ = (count + kKeys - 1) / kKeys;
+    void *memory;
+    if (posix_memalign(&memory, 64,
+                this->node_count_ * kKeys * sizeof(int64_t)) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    this->keys_ = static_cast<int64_t *>(memory);
+    this->blocks_.resize(this->node_count_ * kKeys);
+
+    // The subtrees are filled concurrently, at least eight of them per
+    // thread so that their uneven sizes even out. A single thread fills
+    // the whole tree as one subtree.
+    unsigned levels = 0;
+    for (size_t roots = 1; this->threads_ > 1 && roots < 8 * this->threads_;
+            roots *= kKeys + 1)
+    {
+        ++levels;
+    }
+    std::vector<std::pair<size_t, size_t> > subtrees;
+    this->fillTop(0, 0, levels, subtrees);
+    ForEachRange(subtrees.size(), this->threads_,
+            [this, &subtrees](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            this->fill(subtrees[i].first, subtrees[i].second);
+        }
+    }, kMinRangeLength * subtrees.size() / std::max<size_t>(1, count));
+}
+
+void STreeAlignmentBlockStorage::dropIndex()
+{
+    free(this->keys_);
+    this->keys_ = NULL;
+    this->node_count_ = 0;
+    std::vector<size_t>().swap(this->blocks_);
+}
+
+size_t STreeAlignmentBlockStorage::fill(size_t next, size_t node)
+{
+    // The in-order walk visits the keys in sorted order; keys left over
+    // at the end are padding.
+    if (node >= this->node_count_)
+    {
+        return next;
+    }
+    for (size_t i = 0; i < kKeys; ++i)
+    {
+        next = this->fill(next, child(node, i));
+        next = this->fillSlot(next, node * kKeys + i);
+    }
+    return this->fill(next, child(node, kKeys));
+}
+
+size_t STreeAlignmentBlockStorage::fillTop(size_t next, size_t node,
+        unsigned levels, std::vector<std::pair<size_t, size_t> > &subtrees)
+{
+    if (node >= this->node_count_)
+    {
+        return next;
+    }
+    if (levels == 0)
+    {
+        // Each slot takes a start until they run out.
+        subtrees.push_back(std::make_pair(next, node));
+        return std::min(this->contents_.size(),
+                next + kKeys * this->subtreeNodes(node));
+    }
+    for (size_t i = 0; i < kKeys; ++i)
+    {
+        next = this->fillTop(next, child(node, i), levels - 1, subtrees);
+        next = this->fillSlot(next, node * kKeys + i);
+    }
+    return this->fillTop(next, child(node, kKeys), levels - 1, subtrees);
+}
+
+size_t STreeAlignmentBlockStorage::fillSlot(size_t next, size_t slot)
+{
+    size_t count = this->contents_.size();
+    if (next < count)
+    {
+        this->keys_[slot] =
+            this->contents_[next]->getReferenceSequence()->get_start();
+        this->blocks_[slot] = next;
+        return next + 1;
+    }
+    this->keys_[slot] = kNoKey;
+    this->blocks_[slot] = count;
+    return next;
+}
+
+size_t STreeAlignmentBlockStorage::subtreeNodes(size_t node) const
+{
+    // Every level of the subtree is a contiguous range of nodes, only the
+    // last one may be cut short.
+    size_t nodes = 0;
+    for (size_t first = node, last = node; first < this->node_count_;
+            first = child(first, 0), last = child(last, kKeys))
+    {
+        nodes += std::min(last, this->node_count_ - 1) - first + 1;
+    }
+    return nodes;
+}
@@ -1,4 +1,6 @@
 #include <string>
+#include <fstream>
+#include <BitSequence.h>
 
 #include <SequenceDetails.h>
 #include <MultialnConstants.h>
@@ -49,3 +51,30 @@ size_t SequenceDetails::alignmentToSequence(size_t index,
     }
     return position;
 }
+
+void SequenceDetails::save(std::ofstream &fp) const
+{
+    cds_utils::saveValue(fp, this->start_);
+    cds_utils::saveValue(fp, this->src_size_);
+    cds_utils::saveValue(fp, this->reverse_);
+    cds_utils::saveValue(fp, this->id_);
+    this->sequence_->save(fp);
+}
+
+SequenceDetails SequenceDetails::load(std::ifstream &fp)
+{
+    size_t start = cds_utils::loadValue<size_t>(fp);
+    size_t src_size = cds_utils::loadValue<size_t>(fp);
+    bool reverse = cds_utils::loadValue<bool>(fp);
+    seqid_t id = cds_utils::loadValue<seqid_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    cds_static::BitSequence *sequence = cds_static::BitSequence::load(fp);
+    if (sequence == NULL)
+    {
+        throw SnapshotError();
+    }
+    return SequenceDetails(start, reverse, src_size, id, sequence);
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <mutex>
+
+#include <VectorAlignmentBlockStorage.h>
+#include <AlignmentBlock.h>
+#include <SequenceDetails.h>
+#include <Parallel.h>
+
+
+namespace
+{
+
+inline size_t startOf(AlignmentBlock *block)
+{
+    return block->getReferenceSequence()->get_start();
+}
+
+struct StartsAfter
+{
+    bool operator()(size_t pos, AlignmentBlock *block) const
+    {
+        return pos < startOf(block);
+    }
+};
+
+} /* namespace */
+
+VectorAlignmentBlockStorage::~VectorAlignmentBlockStorage()
+{
+    // The rows of the blocks may live in the arenas.
+    for (size_t i = 0; i < this->contents_.size(); ++i)
+    {
+        delete this->contents_[i];
+    }
+    for (size_t i = 0; i < this->arenas_.size(); ++i)
+    {
+        delete this->arenas_[i];
+    }
+}
+
+void VectorAlignmentBlockStorage::addBlock(AlignmentBlock *block)
+{
+    if (this->prepared_ || this->index_loaded_)
+    {
+        this->dropIndex();
+        this->prepared_ = false;
+        this->index_loaded_ = false;
+    }
+    // The block is owned by this storage from now on, even if it turns out
+    // to lack the reference sequence.
+    this->contents_.push_back(block);
+    this->pending_.push_back(block);
+    size_t count = this->contents_.size();
+    if (this->sorted_ && count > 1
+            && AlignmentBlock::compareReferencePosition(block,
+                this->contents_[count - 2]))
+    {
+        this->sorted_ = false;
+    }
+}
+
+VectorAlignmentBlockStorage::iterator
+VectorAlignmentBlockStorage::find(const size_t pos)
+{
+    if (this->contents_.empty())
+    {
+        throw OutOfSequence();
+    }
+
+    this->prepare();
+    return iterator(this, this->findIndex(pos));
+}
+
+AlignmentBlock * VectorAlignmentBlockStorage::getBlockNear(const size_t pos,
+        QueryCursor &cursor)
+{
+    if (this->contents_.empty())
+    {
+        throw OutOfSequence();
+    }
+
+    this->prepare();
+    size_t hint = cursor.getHint(), index;
+    if (hint >= this->contents_.size() || !this->gallop(pos, hint, index))
+    {
+        index = this->findIndex(pos);
+    }
+    // Even if pos falls between blocks, the next query will likely be
+    // close by.
+    cursor.setHint(index);
+
+    AlignmentBlock *block = this->contents_[index];
+    block->getReferenceSequence()->sequenceToAlignment(pos);
+    return block;
+}
+
+VectorAlignmentBlockStorage::iterator VectorAlignmentBlockStorage::begin()
+{
+    this->prepare();
+    return iterator(this, 0);
+}
+
+VectorAlignmentBlockStorage::iterator VectorAlignmentBlockStorage::end()
+{
+    this->prepare();
+    return iterator(this, this->contents_.size());
+}
+
+size_t VectorAlignmentBlockStorage::size() const
+{
+    return this->contents_.size();
+}
+
+void VectorAlignmentBlockStorage::prepare()
+{
+    this->prepare(1);
+}
+
+void VectorAlignmentBlockStorage::prepare(size_t threads)
+{
+    if (this->prepared_)
+    {
+        return;
+    }
+    this->threads_ = std::max<size_t>(1, threads);
+    try
+    {
+        if (!this->sorted_)
+        {
+            sortBlocks(this->contents_, this->threads_);
+            this->sorted_ = true;
+        }
+        this->compact();
+        if (!this->index_loaded_)
+        {
+            this->buildIndex();
+        }
+    }
+    catch (...)
+    {
+        this->threads_ = 1;
+        throw;
+    }
+    this->threads_ = 1;
+    this->prepared_ = true;
+}
+
+void VectorAlignmentBlockStorage::collectStarts(
+        std::vector<size_t> &starts) const
+{
+    starts.resize(this->contents_.size());
+    const Container &blocks = this->contents_;
+    ForEachRange(blocks.size(), this->threads_,
+            [&blocks, &starts](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            starts[i] = startOf(blocks[i]);
+        }
+    });
+}
+
+void VectorAlignmentBlockStorage::compact()
+{
+    if (this->pending_.empty())
+    {
+        return;
+    }
+    // The new blocks are compacted in reference order as well.
+    if (this->pending_.size() < this->contents_.size())
+    {
+        sortBlocks(this->pending_, this->threads_);
+    }
+    else
+    {
+        this->pending_ = this->contents_;
+    }
+
+    // The rows of each range of blocks go in an arena of their own, so
+    // that the ranges can be compacted concurrently. No more ranges than
+    // threads, so adding the arenas never reallocates.
+    this->arenas_.reserve(this->arenas_.size() + this->threads_);
+    const Container &pending = this->pending_;
+    std::vector<Arena *> &arenas = this->arenas_;
+    std::mutex mutex;
+    ForEachRange(pending.size(), this->threads_,
+            [&pending, &arenas, &mutex](size_t begin, size_t end)
+    {
+        size_t rows = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            rows += pending[i]->getSequences().size();
+        }
+        Arena *arena = new Arena(rows * sizeof(SequenceDetails));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            arenas.push_back(arena);
+        }
+        AlignmentBlock::RowAllocator allocator(arena);
+        for (size_t i = begin; i < end; ++i)
+        {
+            // Blocks compacted before a failed attempt are skipped.
+            if (!pending[i]->hasCompactRows())
+            {
+                pending[i]->compactRows(allocator);
+            }
+        }
+    });
+    Container().swap(this->pending_);
+}
+
+bool VectorAlignmentBlockStorage::gallop(const size_t pos, size_t hint,
+        size_t &index) const
+{
+    const Container &blocks = this->contents_;
+    // The block wanted lies in [low, high), with low starting at or
+    // before pos and high after it, if there is any such block.
+    size_t low, high;
+    if (startOf(blocks[hint]) <= pos)
+    {
+        low = hint;
+        for (size_t step = 1; ; step *= 2)
+        {
+            if (step > kMaxGallop)
+            {
+                return false;
+            }
+            high = low + step;
+            if (high >= blocks.size())
+            {
+                high = blocks.size();
+                break;
+            }
+            if (startOf(blocks[high]) > pos)
+            {
+                break;
+            }
+            low = high;
+        }
+    }
+    else
+    {
+        high = hint;
+        for (size_t step = 1; ; step *= 2)
+        {
+            if (step > kMaxGallop)
+            {
+                return false;
+            }
+            if (step > high)
+            {
+                if (startOf(blocks[0]) > pos)
+                {
+                    throw OutOfSequence();
+                }
+                low = 0;
+                break;
+            }
+            low = high - step;
+            if (startOf(blocks[low]) <= pos)
+            {
+                break;
+            }
+            high = low;
+        }
+    }
+
+    index = std::upper_bound(blocks.begin() + low + 1,
+            blocks.begin() + high, pos, StartsAfter()) - blocks.begin() - 1;
+    return true;
+}
@@ -2,6 +2,8 @@
 #include <tuple>
 #include <vector>
 #include <utility>
+#include <fstream>
+#include <BitSequence.h>
 
 #include <WholeGenomeAlignment.h>
 #include <AlignmentBlock.h>
@@ -15,6 +17,49 @@ using std::vector;
 using std::pair;
 using std::make_pair;
 using cds_static::BitSequence;
+using cds_utils::saveValue;
+using cds_utils::loadValue;
+
+namespace
+{
+
+// Identifies snapshot files and their layout version.
+const unsigned int kSnapshotMagic = 0x4e4c414d;
+const unsigned int kSnapshotVersion = 1;
+
+void saveString(std::ofstream &fp, const string &str)
+{
+    saveValue(fp, str.size());
+    fp.write(str.data(), str.size());
+}
+
+string loadString(std::ifstream &fp)
+{
+    size_t length = loadValue<size_t>(fp);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    // Make sure a corrupt length can't make us allocate more than the
+    // file holds.
+    std::streampos pos = fp.tellg();
+    fp.seekg(0, std::ios::end);
+    std::streampos end = fp.tellg();
+    fp.seekg(pos);
+    if (!fp.good() || size_t(end - pos) < length)
+    {
+        throw SnapshotError();
+    }
+    string str(length, ' ');
+    fp.read(&str[0], length);
+    if (!fp.good())
+    {
+        throw SnapshotError();
+    }
+    return str;
+}
+
+} /* namespace */
 
 
 WholeGenomeAlignment::WholeGenomeAlignment(const string &reference,
@@ -22,6 +67,18 @@ WholeGenomeAlignment::WholeGenomeAlignment(const string &reference,
     reference_(reference), storage_(storage)
 {
     this->sequence_name_map_[reference] = kReferenceSequenceId;
+    if (storage != NULL)
+    {
+        try
+        {
+            storage->attach(*this);
+        }
+        catch (...)
+        {
+            delete storage;
+            throw;
+        }
+    }
 }
 
 WholeGenomeAlignment::~WholeGenomeAlignment()
@@ -37,6 +94,15 @@ size_t WholeGenomeAlignment::mapPositionToInformant(size_t position,
     return block->mapPositionToInformant(position, informant_id, boundary);
 }
 
+size_t WholeGenomeAlignment::mapPositionToInformant(size_t position,
+        const string &informant, QueryCursor &cursor,
+        IntervalBoundary boundary) const
+{
+    AlignmentBlock *block = this->storage_->getBlockNear(position, cursor);
+    seqid_t informant_id = this->getSequenceId(informant);
+    return block->mapPositionToInformant(position, informant_id, boundary);
+}
+
 WholeGenomeAlignment::PositionMapping *
 WholeGenomeAlignment::mapPositionToAll(size_t position,
         IntervalBoundary boundary) const
@@ -247,3 +313,65 @@ vector<string> * WholeGenomeAlignment::getSequenceList() const
     }
     return res;
 }
+
+void WholeGenomeAlignment::save(std::ofstream &fp) const
+{
+    saveValue(fp, kSnapshotMagic);
+    saveValue(fp, kSnapshotVersion);
+    saveString(fp, this->reference_);
+    saveValue(fp, this->sequence_details_map_.size());
+    for (auto it = this->sequence_details_map_.begin();
+            it != this->sequence_details_map_.end(); ++it)
+    {
+        saveValue(fp, it->first);
+        saveString(fp, get<0>(it->second));
+        saveValue(fp, get<1>(it->second));
+    }
+    this->storage_->save(fp);
+}
+
+WholeGenomeAlignment * WholeGenomeAlignment::load(std::ifstream &fp,
+        AlignmentBlockStorage *storage)
+{
+    string reference;
+    try
+    {
+        if (loadValue<unsigned int>(fp) != kSnapshotMagic
+                || loadValue<unsigned int>(fp) != kSnapshotVersion)
+        {
+            throw SnapshotError();
+        }
+        reference = loadString(fp);
+    }
+    catch (...)
+    {
+        delete storage;
+        throw;
+    }
+    // Deletes storage on its own if it throws.
+    WholeGenomeAlignment *wga = new WholeGenomeAlignment(reference, storage);
+
+    try
+    {
+        size_t count = loadValue<size_t>(fp);
+        for (size_t i = 0; i < count && fp.good(); ++i)
+        {
+            seqid_t id = loadValue<seqid_t>(fp);
+            string name = loadString(fp);
+            size_t size = loadValue<size_t>(fp);
+            wga->sequence_details_map_[id] = make_tuple(name, size);
+            wga->sequence_name_map_[name] = id;
+        }
+        if (!fp.good())
+        {
+            throw SnapshotError();
+        }
+        storage->load(fp);
+    }
+    catch (...)
+    {
+        delete wga;
+        throw;
+    }
+    return wga;
+}
@@ -1,10 +1,19 @@
 #include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <AlignmentBlock.h>
 #include <SequenceDetails.h>
 #include <AlignmentBlockStorage.h>
 #include <BinSearchAlignmentBlockStorage.h>
 #include <RankAlignmentBlockStorage.h>
+#include <EytzingerAlignmentBlockStorage.h>
+#include <STreeAlignmentBlockStorage.h>
+#include <EliasFanoAlignmentBlockStorage.h>
+#include <LearnedAlignmentBlockStorage.h>
+#include <BucketAlignmentBlockStorage.h>
+#include <OverlapAlignmentBlockStorage.h>
 #include <MultialnConstants.h>
 
 #include "SequenceGenerator.h"
@@ -18,6 +27,30 @@ using ::testing::Types;
 namespace
 {
 
+    struct StartsAfter
+    {
+        bool operator()(size_t pos, AlignmentBlock &block) const
+        {
+            return pos < block.getReferenceSequence()->get_start();
+        }
+    };
+
+    /*
+    ** Adds a block with only a reference row, starting at start and
+    ** covering the 1s of bits, to storage and returns it.
+    */
+    AlignmentBlock * AddBlock(AlignmentBlockStorage &storage, size_t start,
+            size_t ref_size, const string &bits)
+    {
+        SequenceDetails *seq = GenerateSequenceDetails(&fact_rg2, start,
+                ref_size, false, kReferenceSequenceId, bits);
+        AlignmentBlock *block = new AlignmentBlock();
+        block->addSequence(*seq);
+        delete seq;
+        storage.addBlock(block);
+        return block;
+    }
+
     template <typename T>
     class AlignmentBlockStorageTest: public Test
     {
@@ -28,31 +61,10 @@ namespace
             {
                 storage = new T();
 
-                SequenceDetails *seq1, *seq2, *seq3;
-                seq1 = GenerateSequenceDetails(&fact_rg2, 12, 470, false,
-                        kReferenceSequenceId, "001011");
-                seq2 = GenerateSequenceDetails(&fact_rg2, 15, 470, false,
-                        kReferenceSequenceId, "1111111111");
-                seq3 = GenerateSequenceDetails(&fact_rg2, 30, 470, false,
-                        kReferenceSequenceId, "11111");
-
-                AlignmentBlock *block1, *block2, *block3;
-
-                block1 = new AlignmentBlock();
-                block2 = new AlignmentBlock();
-                block3 = new AlignmentBlock();
-
-                block1->addSequence(*seq1);
-                block2->addSequence(*seq2);
-                block3->addSequence(*seq3);
-
-                delete seq1;
-                delete seq2;
-                delete seq3;
-
-                storage->addBlock(block3);
-                storage->addBlock(block1);
-                storage->addBlock(block2);
+                // Added out of order.
+                AddBlock(*storage, 30, 470, "11111");
+                AddBlock(*storage, 12, 470, "001011");
+                AddBlock(*storage, 15, 470, "1111111111");
             }
 
             virtual void TearDown()
@@ -62,7 +74,13 @@ namespace
     };
 
     typedef Types<BinSearchAlignmentBlockStorage,
-            RankAlignmentBlockStorage> AlignmentBlockStorageTypes;
+            RankAlignmentBlockStorage,
+            EytzingerAlignmentBlockStorage,
+            STreeAlignmentBlockStorage,
+            EliasFanoAlignmentBlockStorage,
+            LearnedAlignmentBlockStorage,
+            BucketAlignmentBlockStorage,
+            OverlapAlignmentBlockStorage> AlignmentBlockStorageTypes;
     TYPED_TEST_CASE(AlignmentBlockStorageTest, AlignmentBlockStorageTypes);
 
     TYPED_TEST(AlignmentBlockStorageTest, CorrectSize)
@@ -114,4 +132,353 @@ namespace
         EXPECT_TRUE(it1 == this->storage->end());
     }
 
+    TYPED_TEST(AlignmentBlockStorageTest, RandomAccessIterators)
+    {
+        AlignmentBlockStorage::iterator begin = this->storage->begin(),
+            end = this->storage->end(), it = begin;
+        EXPECT_EQ(3, end - begin);
+        EXPECT_EQ(3, std::distance(begin, end));
+        it += 2;
+        EXPECT_EQ(30, it->getReferenceSequence()->get_start());
+        EXPECT_EQ(2u, it.index());
+        it -= 1;
+        EXPECT_TRUE(it == this->storage->find(15));
+        EXPECT_EQ(12, (--it)->getReferenceSequence()->get_start());
+        EXPECT_TRUE(it == begin);
+        EXPECT_EQ(30, begin[2].getReferenceSequence()->get_start());
+        EXPECT_EQ(15, (1 + begin)->getReferenceSequence()->get_start());
+        EXPECT_TRUE(end - 1 == this->storage->find(32));
+        EXPECT_TRUE(begin < end);
+        EXPECT_TRUE(end >= begin + 3);
+        EXPECT_FALSE(begin > begin);
+
+        // Sorted blocks can be searched with the usual algorithms.
+        it = std::upper_bound(begin, end, 20, StartsAfter());
+        EXPECT_EQ(30, it->getReferenceSequence()->get_start());
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, CompactsRows)
+    {
+        AlignmentBlockStorage::iterator it = this->storage->begin();
+        AlignmentBlock *first = &*it;
+        // The rows of consecutive blocks follow each other.
+        const AlignmentBlock::Rows &rows = first->getSequences();
+        const SequenceDetails *row = &rows[0];
+        EXPECT_TRUE(first->hasCompactRows());
+        EXPECT_EQ(&rows[0] + rows.size(), &it[1].getSequences()[0]);
+
+        // Blocks added later get their rows compacted on the next
+        // prepare, without moving anything compacted before.
+        AlignmentBlock *block = AddBlock(*this->storage, 40, 470, "111");
+        this->storage->prepare();
+        it = this->storage->begin();
+        EXPECT_EQ(first, &*it);
+        EXPECT_EQ(row, &it->getSequences()[0]);
+        EXPECT_EQ(block, &it[3]);
+        EXPECT_TRUE(block->hasCompactRows());
+        EXPECT_EQ(12, this->storage->getBlock(13)->getReferenceSequence()
+                ->get_start());
+
+        // Copies of compacted rows outlive the storage.
+        SequenceDetails copy = *row;
+        delete this->storage;
+        this->storage = NULL;
+        EXPECT_EQ(12, copy.get_start());
+        EXPECT_EQ(3, copy.get_size());
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, MergesSortedRuns)
+    {
+        // Several sorted runs on top of the three blocks from SetUp, as
+        // if they came from separate files.
+        size_t starts[] = {100, 110, 120, 40, 50, 200, 5, 60, 70, 80};
+        for (size_t i = 0; i < sizeof(starts) / sizeof(*starts); ++i)
+        {
+            AddBlock(*this->storage, starts[i], 470, "111");
+        }
+
+        size_t expected[] = {5, 12, 15, 30, 40, 50, 60, 70, 80, 100, 110,
+            120, 200};
+        size_t i = 0;
+        for (AlignmentBlockStorage::iterator it = this->storage->begin();
+                it != this->storage->end(); ++it, ++i)
+        {
+            ASSERT_GT(sizeof(expected) / sizeof(*expected), i);
+            EXPECT_EQ(expected[i], it->getReferenceSequence()->get_start());
+        }
+        EXPECT_EQ(sizeof(expected) / sizeof(*expected), i);
+        EXPECT_EQ(60, this->storage->getBlock(61)->getReferenceSequence()
+                ->get_start());
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, AddsAfterLookup)
+    {
+        EXPECT_EQ(30, this->storage->getBlock(32)->getReferenceSequence()
+                ->get_start());
+
+        // One block in order, one breaking it.
+        size_t starts[] = {40, 2};
+        for (size_t i = 0; i < 2; ++i)
+        {
+            AddBlock(*this->storage, starts[i], 470, "111");
+            EXPECT_EQ(starts[i], this->storage->getBlock(starts[i] + 1)
+                    ->getReferenceSequence()->get_start());
+        }
+        EXPECT_EQ(5, this->storage->size());
+        EXPECT_EQ(2, this->storage->begin()->getReferenceSequence()
+                ->get_start());
+        EXPECT_EQ(30, this->storage->getBlock(32)->getReferenceSequence()
+                ->get_start());
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, FindsInAnySize)
+    {
+        // Trees of every shape up to a few levels.
+        for (size_t count = 1; count <= 90; ++count)
+        {
+            TypeParam storage;
+            for (size_t i = 0; i < count; ++i)
+            {
+                AddBlock(storage, 10 + 3 * i, 470, "11");
+            }
+            for (size_t pos = 0; pos < 10 + 3 * count + 5; ++pos)
+            {
+                if (pos < 10)
+                {
+                    EXPECT_THROW(storage.find(pos), OutOfSequence);
+                    continue;
+                }
+                size_t expected = 10 + 3 * std::min((pos - 10) / 3,
+                        count - 1);
+                EXPECT_EQ(expected, storage.find(pos)
+                        ->getReferenceSequence()->get_start());
+            }
+        }
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, IgnoresReferenceSize)
+    {
+        // A reference far too long for anything of its size to be
+        // allocated; indexes may only depend on the blocks.
+        const size_t reference_size = size_t(1) << 62;
+        const size_t base = size_t(1) << 50;
+        TypeParam storage;
+        for (size_t i = 0; i < 100; ++i)
+        {
+            AddBlock(storage, base + 1000 * i, reference_size, "11");
+        }
+        storage.prepare();
+        EXPECT_THROW(storage.find(base - 1), OutOfSequence);
+        EXPECT_EQ(base, storage.find(base + 999)->getReferenceSequence()
+                ->get_start());
+        EXPECT_EQ(base + 99000, storage.find(base + 123456)
+                ->getReferenceSequence()->get_start());
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, PreparesInParallel)
+    {
+        // Enough blocks for every thread to get a range of its own, added
+        // in scrambled order. The count is prime, so the stride visits
+        // each of them once.
+        const size_t count = 10007;
+        TypeParam storage;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t index = (i * 7919) % count;
+            AddBlock(storage, 10 + 3 * index, 20 + 3 * count, "11");
+        }
+        storage.prepare(4);
+
+        size_t i = 0;
+        for (AlignmentBlockStorage::iterator it = storage.begin();
+                it != storage.end(); ++it, ++i)
+        {
+            EXPECT_EQ(10 + 3 * i, it->getReferenceSequence()->get_start());
+        }
+        EXPECT_EQ(count, i);
+        for (size_t pos = 10; pos < 10 + 3 * count; pos += 2)
+        {
+            EXPECT_EQ(10 + 3 * ((pos - 10) / 3), storage.find(pos)
+                    ->getReferenceSequence()->get_start());
+        }
+    }
+
+    TYPED_TEST(AlignmentBlockStorageTest, FindsNearCursor)
+    {
+        // Enough blocks for far jumps to leave the galloping range.
+        const size_t count = 1500;
+        TypeParam storage;
+        for (size_t i = 0; i < count; ++i)
+        {
+            AddBlock(storage, 10 + 3 * i, 5000, "111");
+        }
+        size_t end = 10 + 3 * count;
+
+        QueryCursor cursor;
+        EXPECT_THROW(storage.getBlockNear(5, cursor), OutOfSequence);
+        for (size_t pos = 10; pos < end; ++pos)
+        {
+            ASSERT_EQ(storage.getBlock(pos), storage.getBlockNear(pos,
+                        cursor)) << pos;
+        }
+        EXPECT_THROW(storage.getBlockNear(end, cursor), OutOfSequence);
+        for (size_t pos = end - 1; pos >= 10; --pos)
+        {
+            ASSERT_EQ(storage.getBlock(pos), storage.getBlockNear(pos,
+                        cursor)) << pos;
+        }
+        EXPECT_THROW(storage.getBlockNear(9, cursor), OutOfSequence);
+
+        size_t state = 12345, pos = 10;
+        for (size_t i = 0; i < 2000; ++i)
+        {
+            state = state * 1103515245 + 12345;
+            // Mostly short hops, now and then a far jump.
+            pos = (i % 10 == 0) ? 10 + (state >> 8) % (end - 10)
+                : std::min(end - 1, std::max<size_t>(10,
+                            pos + (state >> 8) % 41 - 20));
+            ASSERT_EQ(storage.getBlock(pos), storage.getBlockNear(pos,
+                        cursor)) << pos;
+        }
+
+        // A cursor left past the end of a smaller storage still works.
+        TypeParam small;
+        AlignmentBlock *block = AddBlock(small, 10, 5000, "111");
+        EXPECT_EQ(block, small.getBlockNear(11, cursor));
+    }
+
+    TEST(LearnedAlignmentBlockStorageTest, FindsWithIrregularStarts)
+    {
+        // Runs of dense and sparse blocks, some sharing a start, force the
+        // model to split into several pieces.
+        LearnedAlignmentBlockStorage storage(2);
+        std::vector<size_t> starts;
+        size_t start = 5;
+        for (size_t i = 0; i < 300; ++i)
+        {
+            start += (i / 50) % 2 ? 40 + i % 7 : i % 3;
+            starts.push_back(start);
+            AddBlock(storage, start, 20000, "1");
+        }
+
+        LearnedIndexStats stats = storage.getStats();
+        EXPECT_LT(1u, stats.segments);
+        EXPECT_GE(3u, stats.max_error);
+        EXPECT_LT(0u, stats.model_size);
+
+        EXPECT_THROW(storage.find(starts.front() - 1), OutOfSequence);
+        for (size_t pos = starts.front(); pos < start + 10; ++pos)
+        {
+            size_t expected = *(std::upper_bound(starts.begin(),
+                        starts.end(), pos) - 1);
+            ASSERT_EQ(expected, storage.find(pos)->getReferenceSequence()
+                    ->get_start()) << pos;
+        }
+    }
+
+    TEST(LearnedAlignmentBlockStorageTest, FindsAroundLongDuplicateRuns)
+    {
+        // Runs of blocks sharing a start, longer than the error, make the
+        // index jump between neighbouring starts.
+        LearnedAlignmentBlockStorage storage;
+        std::vector<size_t> starts;
+        size_t run_starts[] = {0, 100, 200, 250, 1000};
+        size_t run_lengths[] = {1, 100, 1, 80, 3};
+        for (size_t i = 0; i < 5; ++i)
+        {
+            for (size_t j = 0; j < run_lengths[i]; ++j)
+            {
+                starts.push_back(run_starts[i]);
+                AddBlock(storage, run_starts[i], 20000, "1");
+            }
+        }
+        EXPECT_GT(run_lengths[1], storage.getStats().max_error);
+
+        for (size_t pos = 0; pos < 1010; ++pos)
+        {
+            size_t expected = *(std::upper_bound(starts.begin(),
+                        starts.end(), pos) - 1);
+            ASSERT_EQ(expected, storage.find(pos)->getReferenceSequence()
+                    ->get_start()) << pos;
+        }
+    }
+
+    TEST(BucketAlignmentBlockStorageTest, FindsAcrossEmptyBuckets)
+    {
+        // Clusters of blocks separated by long gaps leave most buckets
+        // empty.
+        BucketAlignmentBlockStorage storage;
+        std::vector<size_t> starts;
+        for (size_t i = 0; i < 64; ++i)
+        {
+            size_t start = 100 + (i / 8) * 5000 + (i % 8) * 3;
+            starts.push_back(start);
+            AddBlock(storage, start, 50000, "1");
+        }
+
+        // About one bucket per block.
+        EXPECT_EQ(10u, storage.getBucketBits());
+        EXPECT_THROW(storage.find(99), OutOfSequence);
+        for (size_t pos = 100; pos < starts.back() + 3000; ++pos)
+        {
+            size_t expected = *(std::upper_bound(starts.begin(),
+                        starts.end(), pos) - 1);
+            ASSERT_EQ(expected, storage.find(pos)->getReferenceSequence()
+                    ->get_start()) << pos;
+        }
+    }
+
+    TEST(OverlapAlignmentBlockStorageTest, FindsAllCoveringBlocks)
+    {
+        // Blocks of very different lengths, nested and overlapping.
+        OverlapAlignmentBlockStorage storage;
+        std::vector<std::pair<size_t, size_t> > ranges;
+        size_t state = 777;
+        for (size_t i = 0; i < 300; ++i)
+        {
+            state = state * 1103515245 + 12345;
+            size_t start = 20 + (state >> 8) % 3000;
+            size_t length = (i % 25 == 0) ? 400 + (state >> 4) % 400
+                : 1 + (state >> 16) % 20;
+            ranges.push_back(std::make_pair(start, start + length));
+            AddBlock(storage, start, 5000, string(length, '1'));
+        }
+
+        std::vector<AlignmentBlock *> found;
+        for (size_t pos = 0; pos < 4000; ++pos)
+        {
+            size_t expected = 0, last_start = 0;
+            for (size_t i = 0; i < ranges.size(); ++i)
+            {
+                if (ranges[i].first <= pos && pos < ranges[i].second)
+                {
+                    ++expected;
+                    last_start = std::max(last_start, ranges[i].first);
+                }
+            }
+            ASSERT_EQ(expected, storage.findAll(pos, found)) << pos;
+            ASSERT_EQ(expected, found.size());
+            for (size_t i = 0; i < found.size(); ++i)
+            {
+                const SequenceDetails *ref = found[i]->getReferenceSequence();
+                EXPECT_LE(ref->get_start(), pos);
+                EXPECT_GT(ref->get_start() + ref->get_size(), pos);
+                if (i > 0)
+                {
+                    EXPECT_LE(found[i - 1]->getReferenceSequence()
+                            ->get_start(), ref->get_start());
+                }
+            }
+            if (expected == 0)
+            {
+                EXPECT_THROW(storage.getBlock(pos), OutOfSequence);
+            }
+            else
+            {
+                EXPECT_EQ(last_start, storage.getBlock(pos)
+                        ->getReferenceSequence()->get_start());
+            }
+        }
+    }
+
 } /* namespace */
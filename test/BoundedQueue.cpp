@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include <BoundedQueue.h>
+
+
+namespace
+{
+    TEST(BoundedQueueTest, PassesItemsInOrder)
+    {
+        BoundedQueue<int> queue(3);
+        std::thread producer([&]()
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                queue.push(i);
+            }
+            queue.close();
+        });
+
+        int item, expected = 0;
+        while (queue.pop(item))
+        {
+            EXPECT_EQ(expected, item);
+            ++expected;
+        }
+        EXPECT_EQ(1000, expected);
+        producer.join();
+    }
+
+    TEST(BoundedQueueTest, CloseReleasesWaiters)
+    {
+        BoundedQueue<int> queue(1);
+        EXPECT_TRUE(queue.push(1));
+        std::thread producer([&]()
+        {
+            // Blocks until the queue is closed.
+            EXPECT_FALSE(queue.push(2));
+        });
+        queue.close();
+        producer.join();
+
+        // Items already in the queue can still be taken out.
+        int item;
+        EXPECT_TRUE(queue.pop(item));
+        EXPECT_EQ(1, item);
+        EXPECT_FALSE(queue.pop(item));
+        EXPECT_FALSE(queue.push(3));
+    }
+}  // namespace
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include <EliasFano.h>
+
+
+using std::vector;
+
+namespace
+{
+    /*
+    ** Compares rank with counting over all values up to a little past
+    ** the last one.
+    */
+    void ExpectRanksMatch(const vector<uint64_t> &values)
+    {
+        EliasFano encoded;
+        encoded.reset(values.size(), values.empty() ? 0 : values.back());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            encoded.push_back(values[i]);
+        }
+        encoded.finish();
+        ASSERT_EQ(values.size(), encoded.size());
+
+        uint64_t last = values.empty() ? 0 : values.back();
+        for (uint64_t value = 0; value <= last + 70; ++value)
+        {
+            size_t expected = std::upper_bound(values.begin(),
+                    values.end(), value) - values.begin();
+            ASSERT_EQ(expected, encoded.rank(value)) << value;
+        }
+        EXPECT_EQ(values.size(), encoded.rank(~uint64_t(0)));
+    }
+
+    TEST(EliasFanoTest, EmptyAndSingle)
+    {
+        ExpectRanksMatch(vector<uint64_t>());
+        ExpectRanksMatch(vector<uint64_t>(1, 0));
+        ExpectRanksMatch(vector<uint64_t>(1, 1000));
+    }
+
+    TEST(EliasFanoTest, Duplicates)
+    {
+        vector<uint64_t> values;
+        for (uint64_t i = 0; i < 50; ++i)
+        {
+            values.push_back(i / 7 * 13);
+        }
+        ExpectRanksMatch(values);
+    }
+
+    TEST(EliasFanoTest, VariousDensities)
+    {
+        // From every value present to sparse ones spanning many zero
+        // samples.
+        uint64_t gaps[] = {1, 2, 5, 64, 1000};
+        for (size_t g = 0; g < sizeof(gaps) / sizeof(*gaps); ++g)
+        {
+            vector<uint64_t> values;
+            uint64_t value = 3, state = 47;
+            for (size_t i = 0; i < 2000; ++i)
+            {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                value += (state >> 33) % gaps[g];
+                values.push_back(value);
+            }
+            ExpectRanksMatch(values);
+        }
+    }
+
+    TEST(EliasFanoTest, AssignsOverThreads)
+    {
+        // Enough values, duplicates included, for the values as well as
+        // the words of high bits to be split into several ranges.
+        vector<size_t> values;
+        uint64_t value = 5, state = 11;
+        for (size_t i = 0; i < 300000; ++i)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            value += (state >> 33) % 16;
+            values.push_back(value);
+        }
+        EliasFano encoded;
+        encoded.assign(values, 4);
+        ASSERT_EQ(values.size(), encoded.size());
+        for (uint64_t value = 0; value <= values.back() + 70; ++value)
+        {
+            size_t expected = std::upper_bound(values.begin(),
+                    values.end(), value) - values.begin();
+            ASSERT_EQ(expected, encoded.rank(value)) << value;
+        }
+
+        encoded.assign(vector<size_t>(), 4);
+        EXPECT_EQ(0, encoded.size());
+        EXPECT_EQ(0, encoded.rank(0));
+    }
+
+    TEST(EliasFanoTest, SizeDependsOnCount)
+    {
+        EliasFano encoded;
+        encoded.reset(1000, uint64_t(3) << 30);
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            encoded.push_back(i << 20);
+        }
+        encoded.finish();
+        EXPECT_EQ(1000, encoded.rank(uint64_t(3) << 30));
+        // Far below the 3 Gbit a bitmap over the universe would take.
+        EXPECT_GT(10000, encoded.getSize());
+    }
+}  // namespace
@@ -0,0 +1,77 @@
+#include <string>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <BitString.h>
+
+#include <GapScan.h>
+
+
+using std::string;
+using cds_utils::BitString;
+
+namespace
+{
+
+    /*
+    ** Checks FillNonGapBits against the obvious bit by bit construction.
+    */
+    void VerifyRow(const string &row)
+    {
+        BitString expected(row.size()), actual(row.size());
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            expected.setBit(i, row[i] != '-');
+        }
+        FillNonGapBits(row.data(), row.size(), actual);
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            ASSERT_EQ(expected.getBit(i), actual.getBit(i))
+                << "length " << row.size() << ", column " << i;
+        }
+    }
+
+    TEST(GapScanTest, Empty)
+    {
+        VerifyRow("");
+    }
+
+    TEST(GapScanTest, ShortRows)
+    {
+        VerifyRow("-");
+        VerifyRow("A");
+        VerifyRow("AAA-GGGAATGTTAACCAAATGA---ATTGTCTCTTACGGTG");
+        VerifyRow(string(31, '-') + "a");
+        VerifyRow("a" + string(63, '-'));
+    }
+
+    TEST(GapScanTest, AllLengthsAroundVectorWidths)
+    {
+        srand(47);
+        const char alphabet[] = "ACGTacgtN-----";
+        for (size_t length = 0; length <= 300; ++length)
+        {
+            string row(length, ' ');
+            for (size_t i = 0; i < length; ++i)
+            {
+                row[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+            }
+            VerifyRow(row);
+        }
+    }
+
+    TEST(GapScanTest, ClearsPreviousContents)
+    {
+        string row = string(40, '-') + string(30, 'C') + string(5, '-');
+        BitString bitstr(row.size());
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            bitstr.setBit(i, true);
+        }
+        FillNonGapBits(row.data(), row.size(), bitstr);
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            EXPECT_EQ(row[i] != '-', bitstr.getBit(i));
+        }
+    }
+
+}  // namespace
@@ -0,0 +1,68 @@
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "GzipHelpers.h"
+
+
+namespace
+{
+    std::string Deflate(const std::string &data, int window_bits)
+    {
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                window_bits, 8, Z_DEFAULT_STRATEGY);
+        std::string out(deflateBound(&stream, data.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef *>(
+                const_cast<char *>(data.data()));
+        stream.avail_in = data.size();
+        stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+        stream.avail_out = out.size();
+        deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    void AppendLittleEndian(std::string &out, uint32_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            out.push_back(char((value >> (8 * i)) & 0xff));
+        }
+    }
+}  // namespace
+
+std::string CompressGzip(const std::string &data)
+{
+    return Deflate(data, 16 + MAX_WBITS);
+}
+
+std::string CompressBgzf(const std::string &data, size_t block_size)
+{
+    std::string out;
+    size_t pos = 0;
+    do
+    {
+        std::string chunk = data.substr(pos, block_size);
+        pos += chunk.size();
+        std::string compressed = Deflate(chunk, -MAX_WBITS);
+        out += std::string("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0",
+                16);
+        AppendLittleEndian(out, compressed.size() + 25, 2);
+        out += compressed;
+        AppendLittleEndian(out, crc32(0,
+                    reinterpret_cast<const Bytef *>(chunk.data()),
+                    chunk.size()), 4);
+        AppendLittleEndian(out, chunk.size(), 4);
+    }
+    while (pos < data.size());
+    // The end-of-file marker.
+    out += std::string("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0"
+            "\x1b\0\x03\0\0\0\0\0\0\0\0\0", 28);
+    return out;
+}
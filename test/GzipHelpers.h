@@ -0,0 +1,18 @@
+#ifndef GZIPHELPERS_H
+#define GZIPHELPERS_H
+
+#include <string>
+
+
+/*
+** Returns data compressed into a single gzip member.
+*/
+std::string CompressGzip(const std::string &data);
+
+/*
+** Returns data compressed into BGZF blocks holding block_size bytes each,
+** followed by the empty end-of-file block, the same way bgzip does.
+*/
+std::string CompressBgzf(const std::string &data, size_t block_size);
+
+#endif /* GZIPHELPERS_H */
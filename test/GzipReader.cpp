@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <zlib.h>
+
+#include <GzipReader.h>
+
+#include "GzipHelpers.h"
+
+
+using std::string;
+
+namespace
+{
+    string MakeText(size_t length)
+    {
+        string text;
+        for (size_t i = 0; text.size() < length; ++i)
+        {
+            text += "s seq" + std::to_string(i % 97) + " ACGT-ACGT\n";
+        }
+        text.resize(length);
+        return text;
+    }
+
+    string ReadAll(const string &compressed, size_t threads, size_t amount)
+    {
+        GzipReader reader(compressed.data(),
+                compressed.data() + compressed.size(), threads);
+        string out;
+        size_t calls = 0;
+        while (reader.read(out, amount))
+        {
+            ++calls;
+            EXPECT_GE(out.size(), calls * amount);
+        }
+        return out;
+    }
+
+    TEST(GzipReaderTest, DetectsFormat)
+    {
+        string text = MakeText(1000);
+        string gzip = CompressGzip(text), bgzf = CompressBgzf(text, 300);
+        const char *gzip_end = gzip.data() + gzip.size(),
+              *bgzf_end = bgzf.data() + bgzf.size();
+        EXPECT_TRUE(GzipReader::isGzip(gzip.data(), gzip_end));
+        EXPECT_FALSE(GzipReader::isBgzf(gzip.data(), gzip_end));
+        EXPECT_TRUE(GzipReader::isGzip(bgzf.data(), bgzf_end));
+        EXPECT_TRUE(GzipReader::isBgzf(bgzf.data(), bgzf_end));
+        EXPECT_FALSE(GzipReader::isGzip(text.data(),
+                    text.data() + text.size()));
+        EXPECT_FALSE(GzipReader::isGzip(gzip.data(), gzip.data() + 1));
+    }
+
+    TEST(GzipReaderTest, Gzip)
+    {
+        string text = MakeText(300000);
+        string gzip = CompressGzip(text);
+        EXPECT_EQ(text, ReadAll(gzip, 1, 1 << 20));
+        EXPECT_EQ(text, ReadAll(gzip, 1, 1000));
+
+        // Concatenated members make up a single file.
+        EXPECT_EQ(text + text, ReadAll(gzip + gzip, 1, 100000));
+    }
+
+    TEST(GzipReaderTest, Bgzf)
+    {
+        string text = MakeText(300000);
+        string bgzf = CompressBgzf(text, 1000);
+        for (size_t threads = 1; threads <= 4; ++threads)
+        {
+            EXPECT_EQ(text, ReadAll(bgzf, threads, 1 << 20));
+            EXPECT_EQ(text, ReadAll(bgzf, threads, 12345));
+        }
+    }
+
+    TEST(GzipReaderTest, FailsOnCorrupt)
+    {
+        string text = MakeText(100000);
+        string bgzf = CompressBgzf(text, 1000);
+        string gzip = CompressGzip(text);
+
+        EXPECT_THROW(ReadAll(gzip.substr(0, gzip.size() / 2), 1, 1 << 20),
+                DecompressionError);
+        EXPECT_THROW(ReadAll(bgzf.substr(0, bgzf.size() / 2), 2, 1 << 20),
+                DecompressionError);
+
+        string corrupt = bgzf;
+        corrupt[corrupt.size() / 2] ^= 0x55;
+        EXPECT_THROW(ReadAll(corrupt, 3, 1 << 20), DecompressionError);
+        EXPECT_THROW(ReadAll(text, 1, 1 << 20), DecompressionError);
+    }
+}  // namespace
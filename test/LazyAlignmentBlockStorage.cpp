@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+
+#include <MafReader.h>
+#include <MafIndex.h>
+#include <LazyAlignmentBlockStorage.h>
+#include <BinSearchAlignmentBlockStorage.h>
+#include <WholeGenomeAlignment.h>
+#include <BitSequenceFactory.h>
+#include <SequenceDetails.h>
+
+
+using std::string;
+using std::vector;
+using maf_reader::MafIndex;
+using maf_reader::IndexMafFile;
+using maf_reader::ReadMafFile;
+
+namespace
+{
+    BitSequenceRRRFactory factory;
+
+    // The blocks are deliberately out of order.
+    const char kTestFile[] = "##maf version=1 scoring=tba.v8\n\
+\n\
+a score=5062.0\n\
+s hg18.chr7    27699739 6 + 158545518 TAAAGA\n\
+s panTro1.chr6 28862317 6 + 161576975 TAAAGA\n\
+s baboon         241163 6 +   4622798 TAAAGA\n\
+s rn3.chr4     81444246 6 + 187371129 taagga\n\
+\n\
+a score=23262.0\n\
+s hg18.chr7    27578828 38 + 158545518 AAA-GGGAATGTTAACCAAATGA---ATTGTCTCTTACGGTG\n\
+s panTro1.chr6 28741140 38 + 161576975 AAA-GGGAATGTTAACCAAATGA---ATTGTCTCTTACGGTG\n\
+s baboon         116834 38 +   4622798 AAA-GGGAATGTTAACCAAATGA---GTTGTCTCTTATGGTG\n\
+s mm4.chr6     53215344 38 + 151104725 -AATGGGAATGTTAAGCAAACGA---ATTGTCTCTCAGTGTG\n\
+\n\
+a score=6636.0\n\
+s hg18.chr7    27707221 13 + 158545518 gcagctgaaaaca\n\
+s mm4.chr6     53310102 13 - 151104725 ACAGCTGAAAATA\n\
+";
+
+    class LazyAlignmentBlockStorageTest: public ::testing::Test
+    {
+        protected:
+            string file_name;
+
+            virtual void SetUp()
+            {
+                char name[] = "/tmp/multialn_test_XXXXXX";
+                close(mkstemp(name));
+                file_name = name;
+                std::ofstream out(name);
+                out << kTestFile;
+            }
+
+            virtual void TearDown()
+            {
+                std::remove(file_name.c_str());
+            }
+    };
+
+    TEST_F(LazyAlignmentBlockStorageTest, IndexesBlocks)
+    {
+        MafIndex *index = IndexMafFile(file_name, "hg18.chr7");
+        EXPECT_EQ("hg18.chr7", index->reference);
+        EXPECT_EQ(sizeof(kTestFile) - 1, index->source_size);
+
+        ASSERT_EQ(3, index->blocks.size());
+        EXPECT_EQ(27578828, index->blocks[0].reference_start);
+        EXPECT_EQ(27578865, index->blocks[0].reference_end);
+        EXPECT_EQ(27699739, index->blocks[1].reference_start);
+        EXPECT_EQ(27707221, index->blocks[2].reference_start);
+        EXPECT_EQ(0, string(kTestFile + index->blocks[1].offset,
+                    index->blocks[1].length).find("a score=5062.0\n"));
+
+        ASSERT_EQ(5, index->sequences.size());
+        EXPECT_EQ("hg18.chr7", index->sequences[0].first);
+        EXPECT_EQ(158545518, index->sequences[0].second);
+        EXPECT_EQ("rn3.chr4", index->sequences[3].first);
+        EXPECT_EQ("mm4.chr6", index->sequences[4].first);
+        delete index;
+    }
+
+    TEST_F(LazyAlignmentBlockStorageTest, SaveAndLoad)
+    {
+        MafIndex *index = IndexMafFile(file_name, "hg18.chr7");
+        char name[] = "/tmp/multialn_test_XXXXXX";
+        close(mkstemp(name));
+        {
+            std::ofstream out(name, std::ios::binary);
+            index->save(out);
+        }
+        MafIndex *loaded = NULL;
+        {
+            std::ifstream in(name, std::ios::binary);
+            ASSERT_NO_THROW(loaded = MafIndex::load(in));
+        }
+        std::remove(name);
+
+        EXPECT_EQ(index->reference, loaded->reference);
+        EXPECT_EQ(index->source_size, loaded->source_size);
+        EXPECT_EQ(index->sequences, loaded->sequences);
+        ASSERT_EQ(index->blocks.size(), loaded->blocks.size());
+        for (size_t i = 0; i < index->blocks.size(); ++i)
+        {
+            EXPECT_EQ(index->blocks[i].reference_start,
+                    loaded->blocks[i].reference_start);
+            EXPECT_EQ(index->blocks[i].offset, loaded->blocks[i].offset);
+            EXPECT_EQ(index->blocks[i].length, loaded->blocks[i].length);
+        }
+        delete index;
+        delete loaded;
+
+        std::ifstream in(file_name.c_str(), std::ios::binary);
+        EXPECT_THROW(MafIndex::load(in), SnapshotError);
+    }
+
+    TEST(MafIndexTest, RejectsCorruptNames)
+    {
+        // The reference name claims more bytes than there are.
+        char name[] = "/tmp/multialn_test_XXXXXX";
+        close(mkstemp(name));
+        {
+            std::ofstream out(name, std::ios::binary);
+            unsigned int header[] = {0x4946414d, 1};
+            size_t length = ~size_t(0);
+            out.write(reinterpret_cast<const char *>(header),
+                    sizeof(header));
+            out.write(reinterpret_cast<const char *>(&length),
+                    sizeof(length));
+            out << "hg18.chr7";
+        }
+        std::ifstream in(name, std::ios::binary);
+        EXPECT_THROW(MafIndex::load(in), SnapshotError);
+        std::remove(name);
+    }
+
+    TEST_F(LazyAlignmentBlockStorageTest, MaterializesOnDemand)
+    {
+        LazyAlignmentBlockStorage *storage = new LazyAlignmentBlockStorage(
+                file_name, IndexMafFile(file_name, "hg18.chr7"), factory);
+        WholeGenomeAlignment wga("hg18.chr7", storage);
+
+        WholeGenomeAlignment full("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        ReadMafFile(file_name, full, factory);
+
+        // All sequences are known up front, with the same IDs.
+        vector<string> *expected = full.getSequenceList();
+        vector<string> *actual = wga.getSequenceList();
+        EXPECT_EQ(*expected, *actual);
+        delete expected;
+        delete actual;
+        EXPECT_EQ(full.getSequenceId("mm4.chr6"),
+                wga.getSequenceId("mm4.chr6"));
+        EXPECT_EQ(3, storage->size());
+        EXPECT_EQ(0, storage->countMaterialized());
+
+        EXPECT_EQ(116836, wga.mapPositionToInformant(27578830, "baboon"));
+        EXPECT_EQ(1, storage->countMaterialized());
+        EXPECT_EQ(116837, wga.mapPositionToInformant(27578831, "baboon"));
+        EXPECT_EQ(1, storage->countMaterialized());
+
+        // Past the end of a block; nothing needs to be parsed.
+        EXPECT_THROW(wga.mapPositionToInformant(27600000, "baboon"),
+                OutOfSequence);
+        EXPECT_THROW(wga.mapPositionToInformant(10, "baboon"),
+                OutOfSequence);
+        EXPECT_EQ(1, storage->countMaterialized());
+
+        EXPECT_EQ(full.mapPositionToInformant(27707225, "mm4.chr6"),
+                wga.mapPositionToInformant(27707225, "mm4.chr6"));
+        EXPECT_THROW(wga.mapPositionToInformant(27707225, "rn3.chr4"),
+                SequenceDoesNotExist);
+        EXPECT_EQ(2, storage->countMaterialized());
+
+        size_t count = 0;
+        for (AlignmentBlockStorage::iterator it = storage->begin();
+                it != storage->end(); ++it, ++count)
+        {
+            EXPECT_NO_THROW(it->getReferenceSequence());
+        }
+        EXPECT_EQ(3, count);
+        EXPECT_EQ(3, storage->countMaterialized());
+    }
+
+    TEST_F(LazyAlignmentBlockStorageTest, RejectsOtherReference)
+    {
+        // The storage is deleted by the failed constructor.
+        LazyAlignmentBlockStorage *storage = new LazyAlignmentBlockStorage(
+                file_name, IndexMafFile(file_name, "hg18.chr7"), factory);
+        EXPECT_THROW(WholeGenomeAlignment("mm4.chr6", storage),
+                SnapshotError);
+    }
+
+    TEST_F(LazyAlignmentBlockStorageTest, RejectsStaleIndex)
+    {
+        MafIndex *index = IndexMafFile(file_name, "hg18.chr7");
+        {
+            std::ofstream out(file_name.c_str(), std::ios::app);
+            out << "\n";
+        }
+        EXPECT_THROW(LazyAlignmentBlockStorage(file_name, index, factory),
+                SnapshotError);
+    }
+}  // namespace
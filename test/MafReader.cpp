@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include <string>
 #include <set>
+#include <vector>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
 
 #include <MafReader.h>
 #include <WholeGenomeAlignment.h>
@@ -9,18 +13,24 @@
 #include <AlignmentBlockStorage.h>
 #include <BinSearchAlignmentBlockStorage.h>
 #include <SequenceDetails.h>
+#include <MappedFile.h>
+#include <GzipReader.h>
+#include <MappedAlignment.h>
+
+#include "GzipHelpers.h"
 
 
 using std::string;
 using std::set;
+using std::vector;
 using maf_reader::ReadMafFile;
 using maf_reader::ParseError;
+using maf_reader::ReadOptions;
 using ::testing::Test;
 
 // A few declarations to be able to test private code...
 namespace maf_reader
 {
-    bool passesLimitCheck(const string &line, const set<string> *limit);
     SequenceDetails parseMafLine(const string &line,
             WholeGenomeAlignment &wga, BitSequenceFactory &factory);
 }  // namespace maf_reader
@@ -28,24 +38,12 @@ namespace maf_reader
 namespace
 {
     using maf_reader::parseMafLine;
-    using maf_reader::passesLimitCheck;
 
     BitSequenceRRRFactory factory;
 
     string test_line = "s hg18.chr7    27578828 38 + 158545518 "
         "AAA-GGGAATGTTAACCAAATGA---ATTGTCTCTTACGGTG";
 
-    TEST(MafReaderTest, LimitCheck)
-    {
-        set<string> limit;
-        limit.insert("random1");
-        limit.insert("random2");
-        EXPECT_FALSE(passesLimitCheck(test_line, &limit));
-        limit.insert("hg18.chr7");
-        EXPECT_TRUE(passesLimitCheck(test_line, &limit));
-        EXPECT_TRUE(passesLimitCheck(test_line, NULL));
-    }
-
     void VerifyParsedTestLine(SequenceDetails *seq,
             WholeGenomeAlignment *wga)
     {
@@ -159,6 +157,550 @@ s mm4.chr6     53310102 13 + 151104725 ACAGCTGAAAATA\n\
         EXPECT_EQ(5, wga.countKnownSequences());
     }
 
+    /*
+    ** Writes contents into a fresh temporary file and returns its name.
+    */
+    string WriteTemporaryFile(const string &contents)
+    {
+        char name[] = "/tmp/multialn_test_XXXXXX";
+        int fd = mkstemp(name);
+        close(fd);
+        std::ofstream out(name);
+        out << contents;
+        return name;
+    }
+
+    TEST(MafReaderTest, SuccessOnMappedFile)
+    {
+        // Leave out the trailing newline to make sure the parser does not
+        // read past the end of the mapping.
+        string file_name = WriteTemporaryFile(
+                test_file.substr(0, test_file.size() - 1));
+        AlignmentBlockStorage *storage = new BinSearchAlignmentBlockStorage();
+
+        WholeGenomeAlignment wga("hg18.chr7", storage);
+        ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory));
+        std::remove(file_name.c_str());
+
+        EXPECT_EQ(3, storage->size());
+        EXPECT_EQ(5, wga.countKnownSequences());
+        EXPECT_EQ(116836, wga.mapPositionToInformant(27578830,
+                    "baboon"));
+        EXPECT_EQ(28869791, wga.mapPositionToInformant(27707225,
+                    "panTro1.chr6"));
+        EXPECT_EQ(53310114, wga.mapPositionToInformant(27707233,
+                    "mm4.chr6"));
+        EXPECT_THROW(wga.mapPositionToInformant(27707225, "rn3.chr4"),
+                SequenceDoesNotExist);
+    }
+
+    TEST(MafReaderTest, ParallelMatchesSequential)
+    {
+        // Repeat the blocks enough times for each thread to get several
+        // chunks.
+        string contents;
+        for (int i = 0; i < 20; ++i)
+        {
+            contents += test_file;
+        }
+        string file_name = WriteTemporaryFile(contents);
+
+        WholeGenomeAlignment sequential("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        ASSERT_NO_THROW(ReadMafFile(file_name, sequential, factory));
+
+        ReadOptions options;
+        options.threads = 4;
+        AlignmentBlockStorage *storage = new BinSearchAlignmentBlockStorage();
+        WholeGenomeAlignment parallel("hg18.chr7", storage);
+        ASSERT_NO_THROW(ReadMafFile(file_name, parallel, factory, options));
+
+        AlignmentBlockStorage *stream_storage =
+            new BinSearchAlignmentBlockStorage();
+        WholeGenomeAlignment parallel_stream("hg18.chr7", stream_storage);
+        istringstream s(contents);
+        ASSERT_NO_THROW(ReadMafFile(s, parallel_stream, factory, options));
+        std::remove(file_name.c_str());
+
+        EXPECT_EQ(60, storage->size());
+        EXPECT_EQ(60, stream_storage->size());
+
+        vector<string> *expected = sequential.getSequenceList();
+        vector<string> *actual = parallel.getSequenceList();
+        EXPECT_EQ(*expected, *actual);
+        delete actual;
+        actual = parallel_stream.getSequenceList();
+        EXPECT_EQ(*expected, *actual);
+        delete actual;
+        delete expected;
+
+        EXPECT_EQ(sequential.getSequenceId("rn3.chr4"),
+                parallel.getSequenceId("rn3.chr4"));
+        EXPECT_EQ(116836, parallel.mapPositionToInformant(27578830,
+                    "baboon"));
+        EXPECT_EQ(28869791, parallel_stream.mapPositionToInformant(27707225,
+                    "panTro1.chr6"));
+    }
+
+    TEST(MafReaderTest, SuccessOnCompressedFile)
+    {
+        string contents;
+        for (int i = 0; i < 20; ++i)
+        {
+            contents += test_file;
+        }
+        const string compressed[] = {
+            CompressGzip(contents),
+            CompressBgzf(contents, 1000)
+        };
+        for (size_t i = 0; i < 2; ++i)
+        {
+            string file_name = WriteTemporaryFile(compressed[i]);
+            for (size_t threads = 1; threads <= 4; threads += 3)
+            {
+                ReadOptions options;
+                options.threads = threads;
+                AlignmentBlockStorage *storage =
+                    new BinSearchAlignmentBlockStorage();
+                WholeGenomeAlignment wga("hg18.chr7", storage);
+                ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory,
+                            options));
+                EXPECT_EQ(60, storage->size());
+                EXPECT_EQ(5, wga.countKnownSequences());
+                EXPECT_EQ(116836, wga.mapPositionToInformant(27578830,
+                            "baboon"));
+            }
+
+            // Cut the file short.
+            std::remove(file_name.c_str());
+            file_name = WriteTemporaryFile(
+                    compressed[i].substr(0, compressed[i].size() / 2));
+            WholeGenomeAlignment wga("hg18.chr7",
+                    new BinSearchAlignmentBlockStorage());
+            EXPECT_THROW(ReadMafFile(file_name, wga, factory),
+                    DecompressionError);
+            std::remove(file_name.c_str());
+        }
+    }
+
+    TEST(MafReaderTest, ReadsSeveralFiles)
+    {
+        // The blocks of test_file spread over three files, out of order
+        // and one of them compressed.
+        size_t second = test_file.find("\na score=5062.0");
+        size_t third = test_file.find("\na score=6636.0");
+        vector<string> file_names;
+        file_names.push_back(WriteTemporaryFile(test_file.substr(third)));
+        file_names.push_back(WriteTemporaryFile(
+                    test_file.substr(0, second)));
+        file_names.push_back(WriteTemporaryFile(CompressGzip(
+                        test_file.substr(second, third - second))));
+
+        istringstream s(test_file);
+        WholeGenomeAlignment expected("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        ASSERT_NO_THROW(ReadMafFile(s, expected, factory));
+
+        const char *informants[] = {"panTro1.chr6", "baboon", "mm4.chr6",
+            "rn3.chr4"};
+        size_t positions[] = {27578828, 27578850, 27699739, 27707233};
+        ReadOptions options;
+        for (size_t threads = 1; threads <= 4; threads += 3)
+        {
+            options.threads = threads;
+            AlignmentBlockStorage *storage =
+                new BinSearchAlignmentBlockStorage();
+            WholeGenomeAlignment wga("hg18.chr7", storage);
+            ASSERT_NO_THROW(maf_reader::ReadMafFiles(file_names, wga,
+                        factory, options));
+            EXPECT_EQ(3, storage->size());
+            EXPECT_EQ(5, wga.countKnownSequences());
+            // IDs follow the order of files, regardless of threads.
+            // rn3.chr4 is missing from the block in the first one.
+            EXPECT_EQ(1, wga.getSequenceId("panTro1.chr6"));
+            EXPECT_EQ(3, wga.getSequenceId("mm4.chr6"));
+            EXPECT_EQ(4, wga.getSequenceId("rn3.chr4"));
+            for (size_t i = 0; i < 4; ++i)
+            {
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    if (string(informants[i]) == "rn3.chr4" && j == 3)
+                    {
+                        continue;
+                    }
+                    EXPECT_EQ(expected.mapPositionToInformant(positions[j],
+                                informants[i]),
+                            wga.mapPositionToInformant(positions[j],
+                                informants[i]));
+                }
+            }
+        }
+
+        // A missing file fails the whole read.
+        file_names.push_back("/nonexistent/file.maf");
+        options.threads = 4;
+        WholeGenomeAlignment missing("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        EXPECT_THROW(maf_reader::ReadMafFiles(file_names, missing, factory,
+                    options), FileMappingError);
+        file_names.pop_back();
+
+        for (size_t i = 0; i < file_names.size(); ++i)
+        {
+            std::remove(file_names[i].c_str());
+        }
+    }
+
+    TEST(MafReaderTest, ListsMafFiles)
+    {
+        char directory[] = "/tmp/multialn_test_XXXXXX";
+        ASSERT_TRUE(mkdtemp(directory) != NULL);
+        const char *names[] = {"chr2.maf", "chr1.maf.gz", "notes.txt",
+            "chr10.maf"};
+        for (size_t i = 0; i < 4; ++i)
+        {
+            std::ofstream out((string(directory) + "/" + names[i]).c_str());
+        }
+
+        vector<string> file_names = maf_reader::ListMafFiles(directory);
+        ASSERT_EQ(3, file_names.size());
+        EXPECT_EQ(string(directory) + "/chr1.maf.gz", file_names[0]);
+        EXPECT_EQ(string(directory) + "/chr10.maf", file_names[1]);
+        EXPECT_EQ(string(directory) + "/chr2.maf", file_names[2]);
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            std::remove((string(directory) + "/" + names[i]).c_str());
+        }
+        rmdir(directory);
+        EXPECT_THROW(maf_reader::ListMafFiles(directory), FileMappingError);
+    }
+
+    /*
+    ** Returns a MAF of count blocks on hg18.chr7 with two informants, one
+    ** of them on the reverse strand and missing from every third block.
+    ** The blocks are not sorted by the reference.
+    */
+    string GenerateMaf(size_t count)
+    {
+        std::ostringstream maf;
+        maf << "##maf version=1\n\n";
+        unsigned state = 47;
+        for (size_t b = 0; b < count; ++b)
+        {
+            // Visit the blocks in a scrambled order.
+            size_t block = (b * 37) % count;
+            string rows[3];
+            size_t sizes[3] = {0, 0, 0};
+            for (size_t column = 0; column < 40; ++column)
+            {
+                for (size_t r = 0; r < 3; ++r)
+                {
+                    state = state * 1103515245 + 12345;
+                    bool gap = ((state >> 16) % 4) == 0;
+                    rows[r] += gap ? '-' : 'A';
+                    sizes[r] += gap ? 0 : 1;
+                }
+            }
+            maf << "a score=" << block << "\n";
+            maf << "s hg18.chr7 " << block * 50 << " " << sizes[0]
+                << " + 100000 " << rows[0] << "\n";
+            maf << "s inf1 " << block * 45 << " " << sizes[1]
+                << " + 90000 " << rows[1] << "\n";
+            if (block % 3 != 0)
+            {
+                maf << "s inf2 " << block * 42 << " " << sizes[2]
+                    << " - 80000 " << rows[2] << "\n";
+            }
+            maf << "\n";
+        }
+        return maf.str();
+    }
+
+    TEST(MafReaderTest, BuildsMappedAlignment)
+    {
+        string file_name = WriteTemporaryFile(GenerateMaf(300));
+        WholeGenomeAlignment wga("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory));
+
+        // A tiny budget spills a run every few blocks, a large one keeps
+        // everything in memory.
+        size_t budgets[] = {4096, 1 << 30};
+        for (size_t i = 0; i < 2; ++i)
+        {
+            string output = WriteTemporaryFile("");
+            ASSERT_NO_THROW(maf_reader::BuildMappedAlignment(file_name,
+                        "hg18.chr7", output, budgets[i], ReadOptions()));
+            std::ifstream run((output + ".run0").c_str());
+            EXPECT_FALSE(run.good());
+
+            MappedAlignment mapped(output);
+            EXPECT_EQ(300, mapped.countBlocks());
+            const char *informants[] = {"inf1", "inf2"};
+            for (size_t position = 0; position < 15100; ++position)
+            {
+                for (size_t j = 0; j < 2; ++j)
+                {
+                    size_t expected = 0, actual = 0;
+                    bool expected_fails = false, actual_fails = false;
+                    try
+                    {
+                        expected = wga.mapPositionToInformant(position,
+                                informants[j]);
+                    }
+                    catch (...)
+                    {
+                        expected_fails = true;
+                    }
+                    try
+                    {
+                        actual = mapped.mapPositionToInformant(position,
+                                informants[j]);
+                    }
+                    catch (...)
+                    {
+                        actual_fails = true;
+                    }
+                    ASSERT_EQ(expected_fails, actual_fails) << position;
+                    ASSERT_EQ(expected, actual) << position;
+                }
+            }
+            std::remove(output.c_str());
+        }
+        std::remove(file_name.c_str());
+    }
+
+    TEST(MafReaderTest, FailsOnMissingFile)
+    {
+        WholeGenomeAlignment wga("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        EXPECT_THROW(ReadMafFile("/nonexistent/file.maf", wga, factory),
+                FileMappingError);
+    }
+
+    TEST(MafReaderTest, RespectsLimit)
+    {
+        set<string> limit;
+        limit.insert("hg18.chr7");
+        limit.insert("baboon");
+
+        istringstream s(test_file);
+        AlignmentBlockStorage *storage = new BinSearchAlignmentBlockStorage();
+        WholeGenomeAlignment wga("hg18.chr7", storage);
+        ASSERT_NO_THROW(ReadMafFile(s, wga, factory, &limit));
+
+        EXPECT_EQ(3, storage->size());
+        EXPECT_EQ(2, wga.countKnownSequences());
+        EXPECT_EQ(116836, wga.mapPositionToInformant(27578830,
+                    "baboon"));
+        EXPECT_THROW(wga.mapPositionToInformant(27578830, "panTro1.chr6"),
+                SequenceDoesNotExist);
+    }
+
+    TEST(MafReaderTest, RespectsIntervals)
+    {
+        vector<std::pair<size_t, size_t> > intervals;
+        ReadOptions options;
+        options.intervals = &intervals;
+
+        // The last position of the first block and a range starting
+        // within the last one.
+        intervals.push_back(std::make_pair(27707233, 30000000));
+        intervals.push_back(std::make_pair(27578865, 27578865));
+        {
+            istringstream s(test_file);
+            AlignmentBlockStorage *storage =
+                new BinSearchAlignmentBlockStorage();
+            WholeGenomeAlignment wga("hg18.chr7", storage);
+            ASSERT_NO_THROW(ReadMafFile(s, wga, factory, options));
+            EXPECT_EQ(2, storage->size());
+            EXPECT_EQ(116836, wga.mapPositionToInformant(27578830,
+                        "baboon"));
+            EXPECT_THROW(wga.mapPositionToInformant(27699740, "baboon"),
+                    OutOfSequence);
+            EXPECT_EQ(5, wga.countKnownSequences());
+        }
+
+        intervals.clear();
+        intervals.push_back(std::make_pair(27699740, 27699741));
+        intervals.push_back(std::make_pair(27699700, 27699741));
+        intervals.push_back(std::make_pair(10, 20));
+        string contents;
+        for (int i = 0; i < 20; ++i)
+        {
+            contents += test_file;
+        }
+        string file_name = WriteTemporaryFile(contents);
+        for (size_t threads = 1; threads <= 4; threads += 3)
+        {
+            options.threads = threads;
+            AlignmentBlockStorage *storage =
+                new BinSearchAlignmentBlockStorage();
+            WholeGenomeAlignment wga("hg18.chr7", storage);
+            ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory, options));
+            EXPECT_EQ(20, storage->size());
+            EXPECT_EQ(241164, wga.mapPositionToInformant(27699740,
+                        "baboon"));
+        }
+        std::remove(file_name.c_str());
+
+        intervals.clear();
+        istringstream s(test_file);
+        AlignmentBlockStorage *storage = new BinSearchAlignmentBlockStorage();
+        WholeGenomeAlignment wga("hg18.chr7", storage);
+        ASSERT_NO_THROW(ReadMafFile(s, wga, factory, options));
+        EXPECT_EQ(0, storage->size());
+    }
+
+    class RecordingStatsSink: public maf_reader::ReadStatsSink
+    {
+        public:
+            RecordingStatsSink():
+                progress_calls(0), finished_calls(0)
+            { }
+
+            virtual void progress(const maf_reader::ReadStats &stats)
+            {
+                EXPECT_GE(stats.paragraphs, this->last.paragraphs);
+                ++this->progress_calls;
+                this->last = stats;
+            }
+            virtual void finished(const maf_reader::ReadStats &stats)
+            {
+                ++this->finished_calls;
+                this->last = stats;
+            }
+
+            size_t progress_calls, finished_calls;
+            maf_reader::ReadStats last;
+    };
+
+    TEST(MafReaderTest, ReportsStatistics)
+    {
+        string contents;
+        for (int i = 0; i < 20; ++i)
+        {
+            contents += test_file;
+        }
+        string file_name = WriteTemporaryFile(contents);
+        string gzip_name = WriteTemporaryFile(CompressGzip(contents));
+
+        ReadOptions options;
+        options.progress_interval = 0;
+        for (size_t threads = 1; threads <= 4; threads += 3)
+        {
+            options.threads = threads;
+            for (int source = 0; source < 3; ++source)
+            {
+                RecordingStatsSink sink;
+                options.stats = &sink;
+                AlignmentBlockStorage *storage =
+                    new BinSearchAlignmentBlockStorage();
+                WholeGenomeAlignment wga("hg18.chr7", storage);
+                if (source == 0)
+                {
+                    ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory,
+                                options));
+                }
+                else if (source == 1)
+                {
+                    ASSERT_NO_THROW(ReadMafFile(gzip_name, wga, factory,
+                                options));
+                }
+                else
+                {
+                    istringstream s(contents);
+                    ASSERT_NO_THROW(ReadMafFile(s, wga, factory, options));
+                }
+                EXPECT_EQ(1, sink.finished_calls);
+                EXPECT_LT(0, sink.progress_calls);
+                EXPECT_EQ(60, sink.last.paragraphs);
+                EXPECT_EQ(280, sink.last.rows);
+                EXPECT_LT(0, sink.last.bytes_read);
+                EXPECT_GE(contents.size(), sink.last.bytes_read);
+                EXPECT_LE(sink.last.prepare_time, sink.last.total_time);
+                EXPECT_EQ(60, storage->size());
+            }
+        }
+
+        // Filtered out paragraphs are scanned, but not tokenized.
+        vector<std::pair<size_t, size_t> > intervals;
+        intervals.push_back(std::make_pair(27699740, 27699741));
+        options.intervals = &intervals;
+        options.threads = 1;
+        RecordingStatsSink sink;
+        options.stats = &sink;
+        WholeGenomeAlignment wga("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory, options));
+        EXPECT_EQ(20, sink.last.paragraphs);
+        EXPECT_EQ(100, sink.last.rows);
+
+        std::remove(file_name.c_str());
+        std::remove(gzip_name.c_str());
+    }
+
+    TEST(MafReaderTest, FiltersBlocks)
+    {
+        string file_name = WriteTemporaryFile(test_file);
+        for (size_t threads = 1; threads <= 4; threads += 3)
+        {
+            // Scores 23262, 5062 and 6636, reference rows of 38, 6 and 13
+            // nucleotides, 4, 4 and 3 informants.
+            for (int filter = 0; filter < 4; ++filter)
+            {
+                ReadOptions options;
+                options.threads = threads;
+                set<string> limit;
+                limit.insert("hg18.chr7");
+                limit.insert("panTro1.chr6");
+                limit.insert("baboon");
+                size_t expected = 2;
+                switch (filter)
+                {
+                    case 0:
+                        options.min_score = 6000;
+                        break;
+                    case 1:
+                        options.min_reference_length = 10;
+                        break;
+                    case 2:
+                        options.min_informants = 4;
+                        break;
+                    case 3:
+                        options.limit = &limit;
+                        options.min_informants = 3;
+                        expected = 0;
+                        break;
+                }
+                AlignmentBlockStorage *storage =
+                    new BinSearchAlignmentBlockStorage();
+                WholeGenomeAlignment wga("hg18.chr7", storage);
+                ASSERT_NO_THROW(ReadMafFile(file_name, wga, factory,
+                            options));
+                EXPECT_EQ(expected, storage->size());
+                if (filter == 0)
+                {
+                    EXPECT_THROW(wga.mapPositionToInformant(27699740,
+                                "baboon"), OutOfSequence);
+                    EXPECT_EQ(249192, wga.mapPositionToInformant(27707231,
+                                "baboon"));
+                }
+            }
+        }
+        std::remove(file_name.c_str());
+
+        string bad_score = "a score=abc\n"
+            "s hg18.chr7 27699739 6 + 158545518 TAAAGA\n";
+        istringstream s(bad_score);
+        ReadOptions options;
+        options.min_score = 0;
+        WholeGenomeAlignment wga("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        EXPECT_THROW(ReadMafFile(s, wga, factory, options), ParseError);
+    }
+
     TEST(MafReaderTest, FailsOnInvalid)
     {
         string invalid_input = "##maf version=1 scoring=tba.v8\n\
@@ -174,5 +716,22 @@ s panTro1.chr6 28741140Invalid! 38 + 161576975 AAA-GGGAATGTTAACCAAATGA---ATTGTCT
 
         WholeGenomeAlignment wga("hg18.chr7", storage);
         EXPECT_THROW(ReadMafFile(s, wga, factory), ParseError);
+
+        ReadOptions options;
+        options.threads = 3;
+        string file_name = WriteTemporaryFile(test_file + "\n"
+                + invalid_input + "\n" + test_file);
+        WholeGenomeAlignment parallel("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        EXPECT_THROW(ReadMafFile(file_name, parallel, factory, options),
+                ParseError);
+        std::remove(file_name.c_str());
+
+        istringstream pipelined_input(test_file + "\n" + invalid_input
+                + "\n" + test_file);
+        WholeGenomeAlignment pipelined("hg18.chr7",
+                new BinSearchAlignmentBlockStorage());
+        EXPECT_THROW(ReadMafFile(pipelined_input, pipelined, factory,
+                    options), ParseError);
     }
 }  // namespace
@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+#include <WholeGenomeAlignment.h>
+#include <BinSearchAlignmentBlockStorage.h>
+#include <MappedAlignment.h>
+#include <MultialnConstants.h>
+
+#include "SequenceGenerator.h"
+#include "BitSequenceFactoryDeclarations.h"
+
+
+using std::string;
+
+namespace
+{
+    const char * const kInformants[] = {
+        "reference", "forwardinf", "reverseinf", "nonexistent"
+    };
+
+    class MappedAlignmentTest: public BitSequenceParamTest
+    {
+        protected:
+
+            WholeGenomeAlignment *al;
+            char file_name[32];
+
+            void addBlock(size_t ref_start, size_t fwd_start,
+                    size_t rev_start, const char *ref, const char *fwd,
+                    const char *rev)
+            {
+                AlignmentBlock *block = new AlignmentBlock();
+                SequenceDetails *seq;
+                seq = GenerateSequenceDetails(GetParam(), ref_start, 240,
+                        false, kReferenceSequenceId, ref);
+                block->addSequence(*seq);
+                delete seq;
+                seq = GenerateSequenceDetails(GetParam(), fwd_start, 150,
+                        false, al->getSequenceId("forwardinf"), fwd);
+                block->addSequence(*seq);
+                delete seq;
+                seq = GenerateSequenceDetails(GetParam(), rev_start, 180,
+                        true, al->getSequenceId("reverseinf"), rev);
+                block->addSequence(*seq);
+                delete seq;
+                al->addBlock(block);
+            }
+
+            virtual void SetUp()
+            {
+                al = new WholeGenomeAlignment("reference",
+                        new BinSearchAlignmentBlockStorage);
+                al->requestSequenceId("reference", 240);
+                al->requestSequenceId("forwardinf", 150);
+                al->requestSequenceId("reverseinf", 180);
+
+                addBlock(20, 10, 50, "111110000011111", "111111100000111",
+                        "000111111111100");
+                addBlock(30, 30, 90, "111110000011111", "111111100000111",
+                        "000111111111100");
+                // Long enough to span several words and rank samples.
+                string ref(1500, '1'), fwd(1500, '0'), rev(1500, '1');
+                for (size_t i = 0; i < fwd.size(); i += 3)
+                {
+                    fwd[i] = '1';
+                    ref[i + 1] = '0';
+                }
+                addBlock(50, 40, 70, "111110000011111", "000111111111100",
+                        "111111100000111");
+                addBlock(60, 0, 0, ref.c_str(), fwd.c_str(), rev.c_str());
+
+                strcpy(file_name, "/tmp/multialn_test_XXXXXX");
+                close(mkstemp(file_name));
+                WriteMappedAlignment(*al, file_name);
+            }
+
+            virtual void TearDown()
+            {
+                std::remove(file_name);
+                delete al;
+            }
+    };
+
+    TEST_P(MappedAlignmentTest, SinglePositions)
+    {
+        MappedAlignment mapped(file_name);
+        EXPECT_EQ(4, mapped.countBlocks());
+        EXPECT_EQ(240, mapped.getReferenceSize());
+
+        EXPECT_EQ(13, mapped.mapPositionToInformant(23, "forwardinf"));
+        EXPECT_EQ(33, mapped.mapPositionToInformant(33, "forwardinf"));
+        EXPECT_THROW(mapped.mapPositionToInformant(10, "forwardinf"),
+                OutOfSequence);
+        EXPECT_THROW(mapped.mapPositionToInformant(23, "nonexistent"),
+                SequenceDoesNotExist);
+    }
+
+    TEST_P(MappedAlignmentTest, SequenceId)
+    {
+        MappedAlignment mapped(file_name);
+        EXPECT_EQ(kReferenceSequenceId, mapped.getSequenceId("reference"));
+        EXPECT_EQ(al->getSequenceId("forwardinf"),
+                mapped.getSequenceId("forwardinf"));
+        EXPECT_EQ(al->getSequenceId("reverseinf"),
+                mapped.getSequenceId("reverseinf"));
+        EXPECT_THROW(mapped.getSequenceId("forward"), SequenceDoesNotExist);
+        EXPECT_THROW(mapped.getSequenceId("forwardinf2"),
+                SequenceDoesNotExist);
+    }
+
+    // Every query has to give the same answer as the in-memory alignment.
+    TEST_P(MappedAlignmentTest, MatchesWholeGenomeAlignment)
+    {
+        MappedAlignment mapped(file_name);
+        const IntervalBoundary boundaries[] = {INTERVAL_BEGIN, INTERVAL_END};
+        for (size_t position = 0; position < 1100; ++position)
+        {
+            for (size_t i = 0; i < 4; ++i)
+            {
+                for (size_t j = 0; j < 2; ++j)
+                {
+                    SCOPED_TRACE(position);
+                    SCOPED_TRACE(kInformants[i]);
+                    size_t expected;
+                    try
+                    {
+                        expected = al->mapPositionToInformant(position,
+                                kInformants[i], boundaries[j]);
+                    }
+                    catch (OutOfSequence &e)
+                    {
+                        EXPECT_THROW(mapped.mapPositionToInformant(position,
+                                    kInformants[i], boundaries[j]),
+                                OutOfSequence);
+                        continue;
+                    }
+                    catch (SequenceDoesNotExist &e)
+                    {
+                        EXPECT_THROW(mapped.mapPositionToInformant(position,
+                                    kInformants[i], boundaries[j]),
+                                SequenceDoesNotExist);
+                        continue;
+                    }
+                    EXPECT_EQ(expected, mapped.mapPositionToInformant(
+                                position, kInformants[i], boundaries[j]));
+                }
+            }
+        }
+    }
+
+    TEST_P(MappedAlignmentTest, RejectsCorruptSections)
+    {
+        string contents;
+        {
+            std::ifstream in(file_name, std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+        }
+        mapped_format::Header header;
+        memcpy(&header, contents.data(), sizeof(header));
+
+        for (int corruption = 0; corruption < 5; ++corruption)
+        {
+            string corrupt = contents;
+            mapped_format::Header *h = reinterpret_cast<
+                mapped_format::Header *>(&corrupt[0]);
+            switch (corruption)
+            {
+                case 0:
+                    // Truncated in the middle of the bits.
+                    corrupt.resize(header.bits_offset + 8);
+                    h = reinterpret_cast<mapped_format::Header *>(
+                            &corrupt[0]);
+                    h->file_size = corrupt.size();
+                    break;
+                case 1:
+                    // Sections overlapping each other.
+                    h->rows_offset = h->block_starts_offset;
+                    break;
+                case 2:
+                    // A row past the end of the bits.
+                    reinterpret_cast<mapped_format::Row *>(
+                            &corrupt[header.rows_offset])->first_word =
+                        header.word_count;
+                    break;
+                case 3:
+                    // A block with rows past the end of the rows.
+                    reinterpret_cast<uint64_t *>(
+                            &corrupt[header.block_rows_offset])[1] =
+                        header.row_count + 1;
+                    break;
+                case 4:
+                    // A name past the end of the file; the middle one is
+                    // the first one a lookup compares with.
+                    reinterpret_cast<mapped_format::Sequence *>(
+                            &corrupt[header.sequences_offset])[1]
+                        .name_offset = header.file_size;
+                    break;
+            }
+            {
+                std::ofstream out(file_name, std::ios::binary);
+                out.write(corrupt.data(), corrupt.size());
+            }
+            SCOPED_TRACE(corruption);
+            // The header is checked when opening the file, the entries
+            // only once a query gets to them.
+            if (corruption < 2)
+            {
+                EXPECT_THROW(MappedAlignment mapped(file_name),
+                        SnapshotError);
+                continue;
+            }
+            MappedAlignment mapped(file_name);
+            EXPECT_THROW(mapped.mapPositionToInformant(23, "forwardinf"),
+                    SnapshotError);
+        }
+    }
+
+    TEST(MappedAlignmentFileTest, RejectsGarbage)
+    {
+        char file_name[] = "/tmp/multialn_test_XXXXXX";
+        close(mkstemp(file_name));
+        {
+            std::ofstream out(file_name, std::ios::binary);
+            out << "This is not an alignment index, but it is long enough "
+                "to hold a header. This is not an alignment index, but it "
+                "is long enough to hold a header.";
+        }
+        EXPECT_THROW(MappedAlignment mapped(file_name), SnapshotError);
+        std::remove(file_name);
+        EXPECT_THROW(MappedAlignment mapped(file_name), FileMappingError);
+    }
+
+    INSTANTIATE_BITSEQ_TEST_P(MappedAlignmentTest);
+
+}  // namespace
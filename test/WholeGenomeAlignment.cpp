@@ -2,10 +2,14 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
 
 #include <WholeGenomeAlignment.h>
 #include <AlignmentBlockStorage.h>
 #include <BinSearchAlignmentBlockStorage.h>
+#include <RankAlignmentBlockStorage.h>
 #include <MultialnConstants.h>
 
 #include "SequenceGenerator.h"
@@ -190,6 +194,96 @@ namespace
         EXPECT_EQ(88, result.second);
     }
 
+    TEST_P(WholeGenomeAlignmentTest, SaveAndLoad)
+    {
+        char file_name[] = "/tmp/multialn_test_XXXXXX";
+        close(mkstemp(file_name));
+        {
+            std::ofstream out(file_name, std::ios::binary);
+            al->save(out);
+        }
+
+        WholeGenomeAlignment *loaded[2] = {NULL, NULL};
+        AlignmentBlockStorage *storages[2] = {
+            new BinSearchAlignmentBlockStorage(),
+            new RankAlignmentBlockStorage()
+        };
+        for (int i = 0; i < 2; ++i)
+        {
+            std::ifstream in(file_name, std::ios::binary);
+            ASSERT_NO_THROW(loaded[i] = WholeGenomeAlignment::load(in,
+                        storages[i]));
+        }
+        std::remove(file_name);
+
+        for (int i = 0; i < 2; ++i)
+        {
+            WholeGenomeAlignment *wga = loaded[i];
+            EXPECT_EQ("reference", wga->get_reference());
+            EXPECT_EQ(240, wga->getReferenceSize());
+            EXPECT_EQ(3, storages[i]->size());
+            EXPECT_EQ(al->getSequenceId("reverseinf"),
+                    wga->getSequenceId("reverseinf"));
+            vector<string> *expected = al->getSequenceList();
+            vector<string> *actual = wga->getSequenceList();
+            EXPECT_EQ(*expected, *actual);
+            delete expected;
+            delete actual;
+
+            EXPECT_EQ(13, wga->mapPositionToInformant(23, "forwardinf"));
+            EXPECT_EQ(33, wga->mapPositionToInformant(33, "forwardinf"));
+            EXPECT_THROW(wga->mapPositionToInformant(10, "forwardinf"),
+                    OutOfSequence);
+            pair<size_t, size_t> result = wga->mapRegionToInformant(20, 34,
+                    "reverseinf");
+            EXPECT_EQ(129, result.first);
+            EXPECT_EQ(88, result.second);
+            // Loaded storages get compacted like any other.
+            EXPECT_TRUE(storages[i]->begin()->hasCompactRows());
+
+            delete wga;
+        }
+    }
+
+    TEST(WholeGenomeAlignmentSnapshotTest, RejectsGarbage)
+    {
+        char file_name[] = "/tmp/multialn_test_XXXXXX";
+        close(mkstemp(file_name));
+        {
+            std::ofstream out(file_name, std::ios::binary);
+            out << "This is not a snapshot.";
+        }
+        std::ifstream in(file_name, std::ios::binary);
+        EXPECT_THROW(WholeGenomeAlignment::load(in,
+                    new BinSearchAlignmentBlockStorage()), SnapshotError);
+        std::remove(file_name);
+    }
+
+    TEST(WholeGenomeAlignmentSnapshotTest, RejectsCorruptNames)
+    {
+        // The reference name claims more bytes than there are, once
+        // absurdly many and once just a few too many.
+        size_t lengths[] = {~size_t(0), 10};
+        for (size_t i = 0; i < sizeof(lengths) / sizeof(*lengths); ++i)
+        {
+            char file_name[] = "/tmp/multialn_test_XXXXXX";
+            close(mkstemp(file_name));
+            {
+                std::ofstream out(file_name, std::ios::binary);
+                unsigned int header[] = {0x4e4c414d, 1};
+                out.write(reinterpret_cast<const char *>(header),
+                        sizeof(header));
+                out.write(reinterpret_cast<const char *>(&lengths[i]),
+                        sizeof(lengths[i]));
+                out << "chr1";
+            }
+            std::ifstream in(file_name, std::ios::binary);
+            EXPECT_THROW(WholeGenomeAlignment::load(in,
+                        new BinSearchAlignmentBlockStorage()), SnapshotError);
+            std::remove(file_name);
+        }
+    }
+
     INSTANTIATE_BITSEQ_TEST_P(WholeGenomeAlignmentTest);
 
 }  // namespace